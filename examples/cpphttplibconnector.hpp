@@ -1,15 +1,127 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <cpp-httplib/httplib.h>
 #include <jsonrpccxx/iclientconnector.hpp>
 #include <jsonrpccxx/server.hpp>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+// Content encoding for the connectors below, available when built with CPPHTTPLIB_ZLIB_SUPPORT (the
+// CMake option WITH_ZLIB). cpp-httplib then inflates gzip and deflate bodies on its own; compressing
+// is left to the connectors so that small messages, where it only adds latency, go out as they are.
+namespace http {
+  enum class Encoding { identity, gzip, deflate };
+
+  inline const char *EncodingName(Encoding encoding) {
+    return encoding == Encoding::gzip ? "gzip" : encoding == Encoding::deflate ? "deflate" : "identity";
+  }
+
+  // Picks the encoding to answer with from an Accept-Encoding header, gzip over deflate unless the
+  // client weighs them differently; codings with q=0 are refused
+  inline Encoding Negotiate(const std::string &acceptEncoding) {
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+    Encoding best = Encoding::identity;
+    double bestWeight = 0;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+      size_t end = acceptEncoding.find(',', pos);
+      if (end == std::string::npos)
+        end = acceptEncoding.size();
+      std::string item = acceptEncoding.substr(pos, end - pos);
+      pos = end + 1;
+      double weight = 1;
+      size_t parameter = item.find(';');
+      if (parameter != std::string::npos) {
+        size_t q = item.find("q=", parameter);
+        if (q != std::string::npos)
+          weight = std::atof(item.c_str() + q + 2);
+        item.erase(parameter);
+      }
+      item.erase(0, item.find_first_not_of(" \t"));
+      item.erase(item.find_last_not_of(" \t") + 1);
+      Encoding encoding = item == "gzip" || item == "x-gzip" || item == "*" ? Encoding::gzip : item == "deflate" ? Encoding::deflate : Encoding::identity;
+      if (encoding != Encoding::identity && weight > bestWeight) {
+        best = encoding;
+        bestWeight = weight;
+      }
+    }
+    return best;
+#else
+    (void)acceptEncoding;
+    return Encoding::identity;
+#endif
+  }
+
+  // Returns false if compression is not available or failed
+  inline bool Compress(std::string_view in, Encoding encoding, int level, std::string &out) {
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+    if (encoding == Encoding::identity)
+      return false;
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // Window bits 15 produce a zlib stream (HTTP's deflate), adding 16 a gzip one
+    if (deflateInit2(&stream, level, Z_DEFLATED, encoding == Encoding::gzip ? 31 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+    out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+#else
+    (void)in, (void)encoding, (void)level, (void)out;
+    return false;
+#endif
+  }
+
+  // Messages shorter than threshold are sent uncompressed; a threshold of 0 disables compression
+  struct Compression {
+    size_t threshold;
+    int level;
+  };
+
+  // Posts a JSON-RPC request, compressed with gzip if it is large enough, and asks for compressed
+  // responses whenever compression is enabled
+  inline httplib::Result Post(httplib::Client &client, const std::string &request, const Compression &compression) {
+    if (compression.threshold == 0)
+      return client.Post("/jsonrpc", request, "application/json");
+    httplib::Headers headers{{"Accept-Encoding", "gzip, deflate"}};
+    std::string compressed;
+    if (request.size() >= compression.threshold && Compress(request, Encoding::gzip, compression.level, compressed)) {
+      headers.emplace("Content-Encoding", "gzip");
+      return client.Post("/jsonrpc", headers, compressed, "application/json");
+    }
+    return client.Post("/jsonrpc", headers, request, "application/json");
+  }
+} // namespace http
+
+// One request at a time. Without keepAlive every call opens a new connection; with it the connection
+// stays open and ties up one server worker for as long as the connector lives.
 class CppHttpLibClientConnector : public jsonrpccxx::IClientConnector {
 public:
-  explicit CppHttpLibClientConnector(const std::string &host, int port) : httpClient(host.c_str(), port) {}
+  explicit CppHttpLibClientConnector(const std::string &host, int port, bool keepAlive = false) : httpClient(host.c_str(), port), compression{0, 0} {
+    httpClient.set_keep_alive(keepAlive);
+    httpClient.set_tcp_nodelay(true);
+  }
+
+  // Compresses requests of at least threshold bytes and accepts compressed responses; no effect
+  // without zlib support
+  void SetCompression(size_t threshold, int level = 6) { compression = http::Compression{threshold, level}; }
+
   std::string Send(const std::string &request) override {
-    auto res = httpClient.Post("/jsonrpc", request, "application/json");
+    auto res = http::Post(httpClient, request, compression);
     if (!res || res->status != 200) {
       throw jsonrpccxx::JsonRpcException(-32003, "client connector error, received status != 200");
     }
@@ -18,46 +130,192 @@ public:
 
 private:
   httplib::Client httpClient;
+  http::Compression compression;
+};
+
+// Thread-safe client sharing up to maxConnections persistent connections between all calling
+// threads. A call takes the most recently used idle connection, or opens a new one while below the
+// limit, or waits for one to be returned. A failed call drops its connection together with all idle
+// ones, as they most likely went stale the same way (e.g. a server restart); calls are not retried.
+class CppHttpLibPooledClientConnector : public jsonrpccxx::IClientConnector {
+public:
+  CppHttpLibPooledClientConnector(std::string host, int port, size_t maxConnections = 8,
+                                  std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+      : host(std::move(host)), port(port), maxConnections(maxConnections == 0 ? 1 : maxConnections), timeout(timeout), compression{0, 0}, mutex(), returned(),
+        idle(), open(0), opened(0) {}
+
+  CppHttpLibPooledClientConnector(const CppHttpLibPooledClientConnector &) = delete;
+  CppHttpLibPooledClientConnector &operator=(const CppHttpLibPooledClientConnector &) = delete;
+
+  // Same as CppHttpLibClientConnector::SetCompression, call before sharing the connector
+  void SetCompression(size_t threshold, int level = 6) { compression = http::Compression{threshold, level}; }
+
+  std::string Send(const std::string &request) override {
+    std::unique_ptr<httplib::Client> client = Acquire();
+    auto res = http::Post(*client, request, compression);
+    bool ok = res && res->status == 200;
+    Release(ok ? std::move(client) : nullptr);
+    if (!ok)
+      throw jsonrpccxx::JsonRpcException(-32003, "client connector error, received status != 200");
+    return res->body;
+  }
+
+  // Connections currently open, idle or in use
+  size_t Connections() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return open;
+  }
+  // Connections opened over the lifetime of the pool, including reopened ones
+  size_t Opened() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return opened;
+  }
+
+private:
+  std::string host;
+  int port;
+  size_t maxConnections;
+  std::chrono::milliseconds timeout;
+  http::Compression compression;
+  std::mutex mutex;
+  std::condition_variable returned;
+  std::vector<std::unique_ptr<httplib::Client>> idle;
+  size_t open;
+  size_t opened;
+
+  std::unique_ptr<httplib::Client> Acquire() {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      returned.wait(lock, [this]() { return !idle.empty() || open < maxConnections; });
+      if (!idle.empty()) {
+        auto client = std::move(idle.back());
+        idle.pop_back();
+        return client;
+      }
+      open++;
+      opened++;
+    }
+    auto client = std::make_unique<httplib::Client>(host.c_str(), port);
+    client->set_keep_alive(true);
+    // Headers and body go out in separate writes, Nagle would hold the body back for the delayed ACK
+    client->set_tcp_nodelay(true);
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(timeout - seconds);
+    client->set_connection_timeout(seconds.count(), micros.count());
+    client->set_read_timeout(seconds.count(), micros.count());
+    client->set_write_timeout(seconds.count(), micros.count());
+    return client;
+  }
+
+  // nullptr reports a failed connection
+  void Release(std::unique_ptr<httplib::Client> client) {
+    std::vector<std::unique_ptr<httplib::Client>> stale;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (client) {
+        idle.push_back(std::move(client));
+      } else {
+        open -= 1 + idle.size();
+        stale.swap(idle);
+      }
+    }
+    returned.notify_all();
+  }
 };
 
+// cpp-httplib serves every connection on one worker thread for as long as it is kept alive, so
+// workers bounds the number of concurrent persistent connections; further ones wait for a worker.
+// keepAliveMaxCount and keepAliveTimeout make the server close busy and idle connections;
+// StopListening() waits for idle persistent connections to time out.
 class CppHttpLibServerConnector {
 public:
-  explicit CppHttpLibServerConnector(jsonrpccxx::JsonRpcServer &server, int port) :
+  // Port 0 picks a free port, see Port(). workers == 0 keeps cpp-httplib's default pool size.
+  explicit CppHttpLibServerConnector(jsonrpccxx::JsonRpcServer &server, int port, std::string address = "localhost", size_t workers = 0,
+                                     size_t keepAliveMaxCount = 100, std::chrono::seconds keepAliveTimeout = std::chrono::seconds(5)) :
     thread(),
     server(server),
     httpServer(),
-    port(port) {
+    port(port),
+    address(std::move(address)),
+    compression{1400, 6},
+    finished(false) {
     httpServer.Post("/jsonrpc",
 		    [this](const httplib::Request &req, httplib::Response &res) {
 		      this->PostAction(req, res);
 		    });
+    if (workers > 0)
+      httpServer.new_task_queue = [workers]() { return new httplib::ThreadPool(workers); };
+    httpServer.set_tcp_nodelay(true);
+    httpServer.set_keep_alive_max_count(keepAliveMaxCount);
+    httpServer.set_keep_alive_timeout(keepAliveTimeout.count());
   }
 
   virtual ~CppHttpLibServerConnector() { StopListening(); }
 
+  // Returns false if already listening or the address cannot be bound. Binds before returning, so
+  // clients may connect right away.
   bool StartListening() {
-    if (httpServer.is_running())
+    if (thread.joinable())
+      return false;
+    if (port == 0)
+      port = httpServer.bind_to_any_port(address.c_str());
+    else if (!httpServer.bind_to_port(address.c_str(), port))
+      return false;
+    if (port < 0) {
+      port = 0;
       return false;
-    this->thread = std::thread([this]() { this->httpServer.listen("localhost", port); });
+    }
+    finished = false;
+    this->thread = std::thread([this]() {
+      this->httpServer.listen_after_bind();
+      finished = true;
+    });
     return true;
   }
 
   void StopListening() {
-    if (httpServer.is_running()) {
-      httpServer.stop();
-      this->thread.join();
-    }
+    if (!thread.joinable())
+      return;
+    // stop() only takes effect once the accept loop runs
+    while (!httpServer.is_running() && !finished)
+      std::this_thread::yield();
+    httpServer.stop();
+    this->thread.join();
   }
 
+  int Port() const { return port; }
+
+  // Responses of at least threshold bytes are compressed for clients that accept it, 0 disables
+  // compression. The default of 1400 bytes keeps responses fitting one packet as they are.
+  void SetCompression(size_t threshold, int level = 6) { compression = http::Compression{threshold, level}; }
+
 private:
   std::thread thread;
   jsonrpccxx::JsonRpcServer &server;
   httplib::Server httpServer;
   int port;
+  std::string address;
+  http::Compression compression;
+  std::atomic<bool> finished;
 
+  // The charset parameter keeps cpp-httplib from compressing "application/json" bodies on its own,
+  // regardless of their size
   void PostAction(const httplib::Request &req,
 		  httplib::Response &res) {
     res.status = 200;
-    res.set_content(this->server.HandleRequest(req.body), "application/json");
+    std::string response = this->server.HandleRequest(req.body);
+    if (compression.threshold > 0 && response.size() >= compression.threshold) {
+      // The encoding of responses this large depends on Accept-Encoding, also when it is identity,
+      // so that caches do not hand a compressed body to a client that did not ask for one
+      res.set_header("Vary", "Accept-Encoding");
+      http::Encoding encoding = http::Negotiate(req.get_header_value("Accept-Encoding"));
+      std::string compressed;
+      if (http::Compress(response, encoding, compression.level, compressed)) {
+        res.set_header("Content-Encoding", http::EncodingName(encoding));
+        res.set_content(compressed, "application/json; charset=utf-8");
+        return;
+      }
+    }
+    res.set_content(response, "application/json; charset=utf-8");
   }
 };
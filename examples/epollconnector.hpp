@@ -0,0 +1,685 @@
+#pragma once
+#include "framing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <jsonrpccxx/iclientconnector.hpp>
+#include <jsonrpccxx/server.hpp>
+#include <memory>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Plain TCP transport for Linux. The server runs a number of epoll event loops sharing one listening
+// socket; every connection stays on the loop that accepted it. Requests are handed to
+// JsonRpcServer::HandleBufferAsync as soon as their frame is complete, so pipelined requests on one
+// connection run concurrently (as far as the server's executors allow) and responses are written in
+// completion order. Match them by id. Responses are written as the segments the server produced,
+// with sendmsg, without copying them into one buffer first.
+
+namespace tcp {
+  inline void SetNoDelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  // Returns a listening non-blocking socket, or -1 with errno set
+  inline int Listen(const std::string &address, int port, bool reusePort = false) {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+      errno = EINVAL;
+      return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+      return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if ((reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+      int error = errno;
+      close(fd);
+      errno = error;
+      return -1;
+    }
+    return fd;
+  }
+
+  // Waits up to timeout for a connection on a listening socket, returns a blocking socket or -1
+  inline int Accept(int listenFd, std::chrono::milliseconds timeout) {
+    pollfd waiting{listenFd, POLLIN, 0};
+    if (poll(&waiting, 1, static_cast<int>(timeout.count())) != 1)
+      return -1;
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0)
+      SetNoDelay(fd);
+    return fd;
+  }
+
+  inline int LocalPort(int fd) {
+    sockaddr_in addr;
+    socklen_t size = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &size) != 0)
+      return -1;
+    return ntohs(addr.sin_port);
+  }
+
+  // Returns a connected blocking socket, throws JsonRpcException on failure
+  inline int Connect(const std::string &host, int port) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+      throw jsonrpccxx::JsonRpcException(-32003, "client connector error, cannot resolve " + host);
+    int fd = -1;
+    for (addrinfo *ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+      if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+      }
+    }
+    freeaddrinfo(result);
+    if (fd < 0)
+      throw jsonrpccxx::JsonRpcException(-32003, "client connector error, cannot connect to " + host + ":" + std::to_string(port));
+    SetNoDelay(fd);
+    return fd;
+  }
+
+  // Writes the parts back to back, with as few system calls as the socket allows
+  template <typename... Parts>
+  inline bool WriteAll(int fd, const Parts &...parts) {
+    iovec iov[] = {iovec{const_cast<char *>(std::string_view(parts).data()), std::string_view(parts).size()}...};
+    size_t first = 0;
+    while (first < sizeof...(Parts)) {
+      if (iov[first].iov_len == 0) {
+        first++;
+        continue;
+      }
+      msghdr message;
+      std::memset(&message, 0, sizeof(message));
+      message.msg_iov = iov + first;
+      message.msg_iovlen = sizeof...(Parts) - first;
+      ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      for (auto written = static_cast<size_t>(n); written > 0; first++) {
+        size_t step = std::min(written, iov[first].iov_len);
+        iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + step;
+        iov[first].iov_len -= step;
+        written -= step;
+        if (iov[first].iov_len > 0)
+          break;
+      }
+    }
+    return true;
+  }
+
+  // Responses waiting to be written on one connection. Every frame is a ResponseBuffer holding the
+  // framing around the response's segments; Write() hands the segments of as many frames as fit into
+  // one sendmsg call to the kernel.
+  class OutputQueue {
+  public:
+    explicit OutputQueue(Framing framing) : framing(framing), frames(), offset(0), bytes(0) {}
+
+    void Push(jsonrpccxx::ResponseBuffer response) {
+      char header[4];
+      jsonrpccxx::ResponseBuffer frame;
+      frame.Append(std::string(FrameHeader(header, response.Size(), framing)));
+      frame.Append(std::move(response));
+      frame.AppendStatic(FrameTrailer(framing));
+      bytes += frame.Size();
+      frames.push_back(std::move(frame));
+    }
+
+    bool Empty() const { return frames.empty(); }
+    // Bytes not written yet
+    size_t Bytes() const { return bytes; }
+
+    // Writes until the queue is empty or the socket is full, returns false if the connection failed
+    bool Write(int fd) {
+      while (!frames.empty()) {
+        iovec iov[maxSegments];
+        size_t count = 0;
+        size_t skip = offset;
+        for (auto frame = frames.begin(); frame != frames.end() && count < maxSegments; ++frame) {
+          for (std::string_view segment : frame->Segments()) {
+            if (skip >= segment.size()) {
+              skip -= segment.size();
+              continue;
+            }
+            iov[count++] = iovec{const_cast<char *>(segment.data() + skip), segment.size() - skip};
+            skip = 0;
+            if (count == maxSegments)
+              break;
+          }
+        }
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n < 0 && errno == EAGAIN)
+          return true;
+        if (n <= 0)
+          return false;
+        Consume(static_cast<size_t>(n));
+      }
+      return true;
+    }
+
+  private:
+    static constexpr size_t maxSegments = 256;
+    Framing framing;
+    std::deque<jsonrpccxx::ResponseBuffer> frames;
+    // Bytes of the first frame already written
+    size_t offset;
+    size_t bytes;
+
+    void Consume(size_t written) {
+      bytes -= written;
+      while (written > 0 && written >= frames.front().Size() - offset) {
+        written -= frames.front().Size() - offset;
+        frames.pop_front();
+        offset = 0;
+      }
+      offset += written;
+    }
+  };
+
+  // Responses completed on other threads, handed to an event loop through an eventfd. Shared with
+  // the response callbacks so that late completions after the loop stopped find it alive.
+  struct Mailbox {
+    Mailbox() : mutex(), responses(), eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), closed(false) {}
+    ~Mailbox() {
+      if (eventFd >= 0)
+        close(eventFd);
+    }
+    Mailbox(const Mailbox &) = delete;
+    Mailbox &operator=(const Mailbox &) = delete;
+
+    void Post(uint64_t id, jsonrpccxx::ResponseBuffer response) {
+      bool wake;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed)
+          return;
+        wake = responses.empty();
+        responses.emplace_back(id, std::move(response));
+      }
+      if (wake)
+        Wake();
+    }
+    void Close() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+      }
+      Wake();
+    }
+    std::vector<std::pair<uint64_t, jsonrpccxx::ResponseBuffer>> Take() {
+      std::vector<std::pair<uint64_t, jsonrpccxx::ResponseBuffer>> result;
+      std::lock_guard<std::mutex> lock(mutex);
+      result.swap(responses);
+      return result;
+    }
+    void Wake() {
+      uint64_t one = 1;
+      ssize_t n = write(eventFd, &one, sizeof(one));
+      (void)n;
+    }
+
+    std::mutex mutex;
+    std::vector<std::pair<uint64_t, jsonrpccxx::ResponseBuffer>> responses;
+    int eventFd;
+    bool closed;
+  };
+} // namespace tcp
+
+// One epoll loop serving the connections it accepted from a shared listening socket
+class EpollEventLoop {
+public:
+  EpollEventLoop(jsonrpccxx::JsonRpcServer &server, Framing framing, int listenFd)
+      : server(server), framing(framing), listenFd(listenFd), epollFd(epoll_create1(EPOLL_CLOEXEC)), mailbox(std::make_shared<tcp::Mailbox>()), connections(),
+        dirty(), nextId(firstConnection), stopping(false), setup(), thread() {
+    if (epollFd < 0 || mailbox->eventFd < 0)
+      throw std::runtime_error(std::string("epoll setup failed: ") + std::strerror(errno));
+    Watch(listenFd, listenerId, EPOLLIN | EPOLLEXCLUSIVE, EPOLL_CTL_ADD);
+    Watch(mailbox->eventFd, mailboxId, EPOLLIN, EPOLL_CTL_ADD);
+  }
+
+  ~EpollEventLoop() {
+    Stop();
+    for (auto &connection : connections)
+      close(connection.second->fd);
+    close(epollFd);
+  }
+
+  EpollEventLoop(const EpollEventLoop &) = delete;
+  EpollEventLoop &operator=(const EpollEventLoop &) = delete;
+
+  void Start() {
+    thread = std::thread([this]() { Run(); });
+  }
+
+  // Responses completing afterwards are dropped
+  void Stop() {
+    if (!thread.joinable())
+      return;
+    stopping = true;
+    mailbox->Close();
+    thread.join();
+  }
+
+  // Runs setup on the loop thread before it serves connections, e.g. to pin it to a CPU
+  void SetSetup(std::function<void()> setup) { this->setup = std::move(setup); }
+
+private:
+  struct Connection {
+    Connection(int fd, Framing framing)
+        : fd(fd), scope(jsonrpccxx::NewRequestScope()), in(framing), out(framing), outstanding(0), readClosed(false), paused(false), writing(false),
+          queued(false), events(EPOLLIN) {}
+    int fd;
+    // rpc.cancel on this connection only reaches its own calls
+    jsonrpccxx::RequestScope scope;
+    FrameDecoder in;
+    tcp::OutputQueue out;
+    // Requests handed to the server and not answered yet
+    size_t outstanding;
+    bool readClosed;
+    // Not reading while the client has too much outstanding, see Backlogged()
+    bool paused;
+    // Waiting for EPOLLOUT
+    bool writing;
+    // Listed in dirty
+    bool queued;
+    // Registered with epoll
+    uint32_t events;
+  };
+
+  static constexpr uint64_t listenerId = 0;
+  static constexpr uint64_t mailboxId = 1;
+  static constexpr uint64_t firstConnection = 2;
+  static constexpr size_t readSize = 64 * 1024;
+  // Per connection: a client that pipelines without reading its responses stops being read once
+  // this many requests are unanswered or this many response bytes are waiting to be written
+  static constexpr size_t maxOutstanding = 1024;
+  static constexpr size_t maxQueuedBytes = 4 * 1024 * 1024;
+
+  jsonrpccxx::JsonRpcServer &server;
+  Framing framing;
+  int listenFd;
+  int epollFd;
+  std::shared_ptr<tcp::Mailbox> mailbox;
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+  // Connections with responses to flush at the end of the current iteration
+  std::vector<uint64_t> dirty;
+  uint64_t nextId;
+  std::atomic<bool> stopping;
+  std::function<void()> setup;
+  std::thread thread;
+
+  inline static thread_local EpollEventLoop *current = nullptr;
+
+  void Watch(int fd, uint64_t id, uint32_t events, int operation) {
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = id;
+    epoll_ctl(epollFd, operation, fd, &event);
+  }
+
+  void Run() {
+    current = this;
+    if (setup)
+      setup();
+    epoll_event events[64];
+    while (!stopping) {
+      int count = epoll_wait(epollFd, events, 64, -1);
+      for (int i = 0; i < count; i++) {
+        uint64_t id = events[i].data.u64;
+        if (id == listenerId) {
+          Accept();
+        } else if (id == mailboxId) {
+          Drain();
+        } else if (auto found = connections.find(id); found != connections.end()) {
+          Connection &connection = *found->second;
+          // Errors and hangups are reported while not reading too, no response can reach the client then
+          if ((connection.readClosed || connection.paused) && (events[i].events & (EPOLLERR | EPOLLHUP))) {
+            Close(id);
+            continue;
+          }
+          if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && !connection.paused && !Read(id, connection))
+            continue;
+          if (events[i].events & EPOLLOUT)
+            Queue(id, connection);
+        }
+      }
+      FlushDirty();
+    }
+  }
+
+  // One connection per wakeup, so that a burst is spread over the loops
+  void Accept() {
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    tcp::SetNoDelay(fd);
+    uint64_t id = nextId++;
+    connections.emplace(id, std::make_unique<Connection>(fd, framing));
+    Watch(fd, id, EPOLLIN, EPOLL_CTL_ADD);
+  }
+
+  // Returns false if the connection was closed
+  bool Read(uint64_t id, Connection &connection) {
+    ssize_t n = recv(connection.fd, connection.in.Reserve(readSize), readSize, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+      return true;
+    if (n <= 0) {
+      connection.readClosed = true;
+      Rearm(id, connection);
+      Queue(id, connection);
+      return true;
+    }
+    connection.in.Commit(static_cast<size_t>(n));
+    return Process(id, connection);
+  }
+
+  // Hands the buffered frames to the server until the connection is backlogged, the rest stays
+  // buffered until its responses were written. Returns false if the connection was closed.
+  bool Process(uint64_t id, Connection &connection) {
+    std::string_view frame;
+    while (!Backlogged(connection) && connection.in.Next(frame)) {
+      connection.outstanding++;
+      std::shared_ptr<tcp::Mailbox> box = mailbox;
+      server.HandleBufferAsync(
+          frame,
+          [this, box, id](jsonrpccxx::ResponseBuffer response) {
+            if (current == this)
+              Deliver(id, std::move(response));
+            else
+              box->Post(id, std::move(response));
+          },
+          connection.scope);
+    }
+    connection.paused = Backlogged(connection);
+    if (connection.in.Failed()) {
+      if (!connection.in.Truncated()) {
+        Close(id);
+        return false;
+      }
+      // Multi-line JSON: the truncated line is answered with a parse error, then the connection closes
+      connection.readClosed = true;
+      Queue(id, connection);
+    }
+    Rearm(id, connection);
+    return true;
+  }
+
+  static bool Backlogged(const Connection &connection) { return connection.outstanding >= maxOutstanding || connection.out.Bytes() >= maxQueuedBytes; }
+
+  // Registers the events the connection waits for, if they changed
+  void Rearm(uint64_t id, Connection &connection) {
+    uint32_t events = (connection.readClosed || connection.paused ? 0 : uint32_t(EPOLLIN)) | (connection.writing ? uint32_t(EPOLLOUT) : 0);
+    if (events != connection.events) {
+      connection.events = events;
+      Watch(connection.fd, id, events, EPOLL_CTL_MOD);
+    }
+  }
+
+  void Drain() {
+    uint64_t value;
+    ssize_t n = read(mailbox->eventFd, &value, sizeof(value));
+    (void)n;
+    for (auto &response : mailbox->Take())
+      Deliver(response.first, std::move(response.second));
+  }
+
+  void Deliver(uint64_t id, jsonrpccxx::ResponseBuffer response) {
+    auto found = connections.find(id);
+    if (found == connections.end())
+      return;
+    Connection &connection = *found->second;
+    connection.outstanding--;
+    connection.out.Push(std::move(response));
+    Queue(id, connection);
+  }
+
+  void Queue(uint64_t id, Connection &connection) {
+    if (!connection.queued) {
+      connection.queued = true;
+      dirty.push_back(id);
+    }
+  }
+
+  // Writes everything answered during this iteration with one sendmsg per connection. Resumed
+  // connections may answer and list themselves again while this runs.
+  void FlushDirty() {
+    for (size_t i = 0; i < dirty.size(); i++) {
+      uint64_t id = dirty[i];
+      auto found = connections.find(id);
+      if (found == connections.end())
+        continue;
+      Connection &connection = *found->second;
+      connection.queued = false;
+      if (!Flush(id, connection))
+        continue;
+      if (connection.readClosed && connection.outstanding == 0 && connection.out.Empty())
+        Close(id);
+    }
+    dirty.clear();
+  }
+
+  // Returns false if the connection was closed
+  bool Flush(uint64_t id, Connection &connection) {
+    if (!connection.out.Write(connection.fd)) {
+      Close(id);
+      return false;
+    }
+    connection.writing = !connection.out.Empty();
+    // Frames buffered while paused are not announced by EPOLLIN again
+    if (connection.paused && !Backlogged(connection) && !connection.readClosed && !Process(id, connection))
+      return false;
+    Rearm(id, connection);
+    return true;
+  }
+
+  void Close(uint64_t id) {
+    auto found = connections.find(id);
+    if (found == connections.end())
+      return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, found->second->fd, nullptr);
+    close(found->second->fd);
+    connections.erase(found);
+  }
+};
+
+class EpollServerConnector {
+public:
+  // Port 0 picks a free port, see Port()
+  explicit EpollServerConnector(jsonrpccxx::JsonRpcServer &server, int port, Framing framing = Framing::newline, size_t loops = 1,
+                                std::string address = "127.0.0.1")
+      : server(server), port(port), framing(framing), loopCount(loops == 0 ? 1 : loops), address(std::move(address)), listenFd(-1), loops() {}
+
+  virtual ~EpollServerConnector() { StopListening(); }
+
+  EpollServerConnector(const EpollServerConnector &) = delete;
+  EpollServerConnector &operator=(const EpollServerConnector &) = delete;
+
+  // Returns false if already listening or the address cannot be bound
+  bool StartListening() {
+    if (listenFd >= 0)
+      return false;
+    listenFd = tcp::Listen(address, port);
+    if (listenFd < 0)
+      return false;
+    port = tcp::LocalPort(listenFd);
+    for (size_t i = 0; i < loopCount; i++)
+      loops.push_back(std::make_unique<EpollEventLoop>(server, framing, listenFd));
+    for (auto &loop : loops)
+      loop->Start();
+    return true;
+  }
+
+  void StopListening() {
+    if (listenFd < 0)
+      return;
+    loops.clear();
+    close(listenFd);
+    listenFd = -1;
+  }
+
+  int Port() const { return port; }
+
+private:
+  jsonrpccxx::JsonRpcServer &server;
+  int port;
+  Framing framing;
+  size_t loopCount;
+  std::string address;
+  int listenFd;
+  std::vector<std::unique_ptr<EpollEventLoop>> loops;
+};
+
+// Blocking client, one call at a time. Reconnects on the next call after a connection failed.
+class TcpClientConnector : public jsonrpccxx::IClientConnector {
+public:
+  TcpClientConnector(std::string host, int port, Framing framing = Framing::newline)
+      : host(std::move(host)), port(port), framing(framing), fd(tcp::Connect(this->host, port)), in(framing) {}
+  ~TcpClientConnector() override {
+    if (fd >= 0)
+      close(fd);
+  }
+  TcpClientConnector(const TcpClientConnector &) = delete;
+  TcpClientConnector &operator=(const TcpClientConnector &) = delete;
+
+  std::string Send(const std::string &request) override {
+    std::string response;
+    SendInto(request, response);
+    return response;
+  }
+
+  // Writes the framing around the request instead of copying it into a frame first
+  void SendInto(const std::string &request, std::string &response) override {
+    if (fd < 0) {
+      fd = tcp::Connect(host, port);
+      in = FrameDecoder(framing);
+    }
+    char header[4];
+    if (!tcp::WriteAll(fd, FrameHeader(header, request.size(), framing), request, FrameTrailer(framing)))
+      Fail("sending request failed");
+    std::string_view frame;
+    while (!in.Next(frame)) {
+      if (in.Failed())
+        Fail("response frame too large");
+      ssize_t n = recv(fd, in.Reserve(64 * 1024), 64 * 1024, 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        Fail("connection closed");
+      in.Commit(static_cast<size_t>(n));
+    }
+    response.assign(frame.data(), frame.size());
+  }
+
+private:
+  std::string host;
+  int port;
+  Framing framing;
+  int fd;
+  FrameDecoder in;
+
+  [[noreturn]] void Fail(const std::string &message) {
+    close(fd);
+    fd = -1;
+    throw jsonrpccxx::JsonRpcException(-32003, "client connector error, " + message);
+  }
+};
+
+// Pipelining client for AsyncJsonRpcClient: Send only writes, a reader thread delivers every message
+// received. Also serves as duplex transport of a JsonRpcPeer, on either end of the connection.
+class TcpAsyncClientConnector : public jsonrpccxx::IAsyncClientConnector {
+public:
+  TcpAsyncClientConnector(const std::string &host, int port, Framing framing = Framing::newline)
+      : TcpAsyncClientConnector(tcp::Connect(host, port), framing) {}
+  // Takes over a connected blocking socket, e.g. one returned by tcp::Accept
+  TcpAsyncClientConnector(int fd, Framing framing)
+      : framing(framing), fd(fd), writeMutex(), handlerMutex(), handler(), reader([this]() { Run(); }) {}
+
+  ~TcpAsyncClientConnector() override {
+    shutdown(fd, SHUT_RDWR);
+    reader.join();
+    close(fd);
+  }
+  TcpAsyncClientConnector(const TcpAsyncClientConnector &) = delete;
+  TcpAsyncClientConnector &operator=(const TcpAsyncClientConnector &) = delete;
+
+  void Send(const std::string &request) override {
+    char header[4];
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (!tcp::WriteAll(fd, FrameHeader(header, request.size(), framing), request, FrameTrailer(framing)))
+      throw jsonrpccxx::JsonRpcException(-32003, "client connector error, sending request failed");
+  }
+
+  void SetMessageHandler(std::function<void(const std::string &)> handler) override {
+    std::lock_guard<std::mutex> lock(handlerMutex);
+    this->handler = std::move(handler);
+  }
+
+private:
+  Framing framing;
+  int fd;
+  std::mutex writeMutex;
+  std::mutex handlerMutex;
+  std::function<void(const std::string &)> handler;
+  std::thread reader;
+
+  void Run() {
+    FrameDecoder in(framing);
+    while (true) {
+      ssize_t n = recv(fd, in.Reserve(64 * 1024), 64 * 1024, 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return;
+      in.Commit(static_cast<size_t>(n));
+      std::string_view frame;
+      while (in.Next(frame)) {
+        if (frame.empty())
+          continue;
+        std::lock_guard<std::mutex> lock(handlerMutex);
+        if (handler)
+          handler(std::string(frame));
+      }
+      if (in.Failed())
+        return;
+    }
+  }
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Message framing for stream transports. Every request frame is answered with exactly one
+// response frame, an empty one for notifications, so blocking clients can pair them up.
+enum class Framing {
+  // One message per line (NDJSON): messages must be serialized without line breaks, which JSON
+  // only allows as whitespace between tokens. A line that ends inside a value is rejected.
+  newline,
+  // Every message is preceded by its length as 4 byte big-endian integer
+  length_prefixed
+};
+
+// The bytes a frame puts before a message of the given size, header provides their storage
+inline std::string_view FrameHeader(char (&header)[4], size_t size, Framing framing) {
+  if (framing == Framing::newline)
+    return std::string_view();
+  auto length = static_cast<uint32_t>(size);
+  header[0] = static_cast<char>(length >> 24);
+  header[1] = static_cast<char>(length >> 16);
+  header[2] = static_cast<char>(length >> 8);
+  header[3] = static_cast<char>(length);
+  return std::string_view(header, 4);
+}
+
+// The bytes a frame puts after the message
+inline std::string_view FrameTrailer(Framing framing) { return framing == Framing::newline ? std::string_view("\n") : std::string_view(); }
+
+inline void AppendFrame(std::string &out, std::string_view message, Framing framing) {
+  char header[4];
+  out += FrameHeader(header, message.size(), framing);
+  out += message;
+  out += FrameTrailer(framing);
+}
+
+// Splits a byte stream into frames. Bytes are read into Reserve()'d space of a buffer that is kept
+// across reads; frames are views into it and valid until the next Reserve().
+class FrameDecoder {
+public:
+  explicit FrameDecoder(Framing framing, size_t maxFrameSize = 16 * 1024 * 1024)
+      : framing(framing), maxFrameSize(maxFrameSize), buffer(), begin(0), end(0), scanned(0), failed(false), truncated(false) {}
+
+  // Returns space for at least size more bytes, followed by Commit(n) with the number actually read
+  char *Reserve(size_t size) {
+    if (begin == end) {
+      begin = end = scanned = 0;
+    } else if (begin > 0 && buffer.size() - end < size) {
+      buffer.erase(0, begin);
+      end -= begin;
+      scanned -= begin;
+      begin = 0;
+    }
+    if (buffer.size() - end < size)
+      buffer.resize(end + size);
+    return &buffer[end];
+  }
+  void Commit(size_t size) { end += size; }
+
+  // Returns false once no complete frame is buffered. Check Failed() afterwards: a frame exceeding
+  // the maximum size or a truncated line leaves the stream unusable.
+  bool Next(std::string_view &frame) {
+    if (failed)
+      return false;
+    if (framing == Framing::newline) {
+      size_t newline = std::string_view(buffer).substr(0, end).find('\n', scanned);
+      if (newline == std::string_view::npos) {
+        scanned = end;
+        failed = end - begin > maxFrameSize;
+        return false;
+      }
+      size_t size = newline - begin;
+      if (size > 0 && buffer[newline - 1] == '\r')
+        size--;
+      frame = std::string_view(buffer).substr(begin, size);
+      begin = scanned = newline + 1;
+      // The message goes on in the next line. This one is still returned, to be answered with a
+      // parse error, the rest of the stream is not.
+      failed = truncated = !Balanced(frame);
+      return true;
+    }
+    if (end - begin < 4)
+      return false;
+    auto byte = [this](size_t i) { return static_cast<uint32_t>(static_cast<unsigned char>(buffer[begin + i])); };
+    size_t size = byte(0) << 24 | byte(1) << 16 | byte(2) << 8 | byte(3);
+    if (size > maxFrameSize) {
+      failed = true;
+      return false;
+    }
+    if (end - begin - 4 < size)
+      return false;
+    frame = std::string_view(buffer).substr(begin + 4, size);
+    begin += 4 + size;
+    scanned = begin;
+    return true;
+  }
+
+  bool Failed() const { return failed; }
+  // Newline framing: the stream failed because a line ended inside a JSON value
+  bool Truncated() const { return truncated; }
+  // True if part of a frame is buffered
+  bool Partial() const { return begin != end; }
+
+private:
+  Framing framing;
+  size_t maxFrameSize;
+  std::string buffer;
+  size_t begin;
+  size_t end;
+  // Newline framing: position up to which no newline was found
+  size_t scanned;
+  bool failed;
+  bool truncated;
+
+  // False if text ends inside a string, object or array. Whether it is valid JSON is left to the parser.
+  static bool Balanced(std::string_view text) {
+    int depth = 0;
+    bool string = false;
+    for (size_t i = 0; i < text.size(); i++) {
+      char c = text[i];
+      if (string) {
+        if (c == '\\')
+          i++;
+        else if (c == '"')
+          string = false;
+      } else if (c == '"') {
+        string = true;
+      } else if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+      }
+    }
+    return !string && depth <= 0;
+  }
+};
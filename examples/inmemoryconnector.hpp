@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <jsonrpccxx/iclientconnector.hpp>
 #include <jsonrpccxx/server.hpp>
 
@@ -7,6 +8,41 @@ class InMemoryConnector : public jsonrpccxx::IClientConnector {
 public:
   explicit InMemoryConnector(jsonrpccxx::JsonRpcServer &server) : server(server) {}
   std::string Send(const std::string &request) override { return server.HandleRequest(request); }
+  void SendInto(const std::string &request, std::string &response) override {
+    response.clear();
+    server.HandleBuffer(request).AppendTo(response);
+  }
 private:
   jsonrpccxx::JsonRpcServer &server;
-};
\ No newline at end of file
+};
+
+//Skips serialization: JsonRpcClient hands requests to the server as objects and takes the result from
+//the response object. Send remains for text-only clients such as BatchClient.
+class InMemoryDirectConnector : public jsonrpccxx::IClientConnector, public jsonrpccxx::IDirectClientConnector {
+public:
+  explicit InMemoryDirectConnector(jsonrpccxx::JsonRpcServer &server) : server(server) {}
+  std::string Send(const std::string &request) override { return server.HandleRequest(request); }
+  nlohmann::json Call(nlohmann::json request) override { return server.HandleJson(std::move(request)); }
+private:
+  jsonrpccxx::JsonRpcServer &server;
+};
+
+//Asynchronous variant, responses are delivered on whichever thread completed the request.
+class InMemoryAsyncConnector : public jsonrpccxx::IAsyncClientConnector {
+public:
+  explicit InMemoryAsyncConnector(jsonrpccxx::JsonRpcServer &server) : server(server), handler(), scope(jsonrpccxx::NewRequestScope()) {}
+  void Send(const std::string &request) override {
+    server.HandleRequestAsync(
+        request,
+        [this](std::string response) {
+          if (!response.empty() && handler)
+            handler(response);
+        },
+        scope);
+  }
+  void SetMessageHandler(std::function<void(const std::string &)> handler) override { this->handler = std::move(handler); }
+private:
+  jsonrpccxx::JsonRpcServer &server;
+  std::function<void(const std::string &)> handler;
+  jsonrpccxx::RequestScope scope;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Collects raw latency samples (nanoseconds) and reports exact percentiles.
+// Each worker thread owns one recorder, they are merged once the run is over.
+class LatencyRecorder {
+public:
+  LatencyRecorder() : samples() {}
+
+  void Reserve(size_t n) { samples.reserve(n); }
+  void Record(std::chrono::nanoseconds latency) { samples.push_back(static_cast<uint64_t>(latency.count())); }
+  void Merge(const LatencyRecorder &other) { samples.insert(samples.end(), other.samples.begin(), other.samples.end()); }
+
+  size_t Count() const { return samples.size(); }
+
+  // Sorts the samples, must be called before Percentile/Max.
+  void Finish() { std::sort(samples.begin(), samples.end()); }
+
+  // Nearest-rank percentile, p in [0, 100].
+  double Percentile(double p) const {
+    if (samples.empty())
+      return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(samples.size()) + 0.5);
+    rank = std::min(std::max<size_t>(rank, 1), samples.size());
+    return static_cast<double>(samples[rank - 1]);
+  }
+
+  double Max() const { return samples.empty() ? 0 : static_cast<double>(samples.back()); }
+
+private:
+  std::vector<uint64_t> samples;
+};
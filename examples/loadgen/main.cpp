@@ -0,0 +1,495 @@
+#include "cpphttplibconnector.hpp"
+#include "epollconnector.hpp"
+#include "shardedserver.hpp"
+#include "shmconnector.hpp"
+#include "uringconnector.hpp"
+#include "inmemoryconnector.hpp"
+#include "latency.hpp"
+#include "warehouse/warehouseapp.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <jsonrpccxx/client.hpp>
+#include <jsonrpccxx/server.hpp>
+
+using namespace jsonrpccxx;
+using namespace std;
+using namespace std::chrono;
+
+// Load generator for JsonRpc2Server.
+//
+// closed mode: every worker sends its next request as soon as the previous one returned.
+// open mode:   requests are issued at a constant arrival rate. Latency is measured from the
+//              intended start time of a request, not from the time it was actually sent, so
+//              that queueing inside the generator is not hidden (coordinated omission).
+
+struct Options {
+  Options()
+      : transport("inmemory"), mode("closed"), threads(4), rate(1000), duration(5), products(100), port(8485), cacheTtl(0), executor("inline"), workers(4),
+        serviceTime(0), maxInFlight(0), queueTarget(0), framing("newline"), loops(1), shards(0), busyPoll(0), httpPool(0), compress(0), mix() {}
+  string transport;
+  string mode;
+  unsigned int threads;
+  double rate;
+  double duration;
+  unsigned int products;
+  int port;
+  int cacheTtl;
+  string executor;
+  unsigned int workers;
+  unsigned int serviceTime;
+  unsigned int maxInFlight;
+  unsigned int queueTarget;
+  string framing;
+  unsigned int loops;
+  unsigned int shards;
+  unsigned int busyPoll;
+  unsigned int httpPool;
+  unsigned int compress;
+  vector<pair<string, unsigned int>> mix;
+};
+
+class Transport {
+public:
+  virtual ~Transport() = default;
+  virtual unique_ptr<IClientConnector> Connect() = 0;
+  virtual json Statistics(JsonRpc2Server &server) { return server.Statistics(); }
+};
+
+// direct: requests and responses are passed as objects instead of text
+class InMemoryTransport : public Transport {
+public:
+  InMemoryTransport(JsonRpcServer &server, bool direct) : server(server), direct(direct) {}
+  unique_ptr<IClientConnector> Connect() override {
+    if (direct)
+      return make_unique<InMemoryDirectConnector>(server);
+    return make_unique<InMemoryConnector>(server);
+  }
+
+private:
+  JsonRpcServer &server;
+  bool direct;
+};
+
+// pool == 0: every client opens a connection per call. Otherwise all clients share a pool of that many
+// persistent connections, served by as many server workers.
+class HttpTransport : public Transport {
+public:
+  HttpTransport(JsonRpcServer &server, int port, size_t pool, size_t compress)
+      : connector(server, port, "localhost", pool), port(port), compress(compress),
+        pool(pool == 0 ? nullptr : make_unique<CppHttpLibPooledClientConnector>("localhost", port, pool)) {
+    if (!connector.StartListening())
+      throw runtime_error("cannot listen on port " + to_string(port));
+    if (this->pool)
+      this->pool->SetCompression(compress);
+  }
+  unique_ptr<IClientConnector> Connect() override {
+    if (pool)
+      return make_unique<SharedConnector>(*pool);
+    auto client = make_unique<CppHttpLibClientConnector>("localhost", port);
+    client->SetCompression(compress);
+    return client;
+  }
+  json Statistics(JsonRpc2Server &server) override {
+    json result = server.Statistics();
+    if (pool)
+      result["transport"] = {{"connections_opened", pool->Opened()}};
+    return result;
+  }
+
+private:
+  class SharedConnector : public IClientConnector {
+  public:
+    explicit SharedConnector(IClientConnector &target) : target(target) {}
+    string Send(const string &request) override { return target.Send(request); }
+
+  private:
+    IClientConnector &target;
+  };
+
+  CppHttpLibServerConnector connector;
+  int port;
+  size_t compress;
+  unique_ptr<CppHttpLibPooledClientConnector> pool;
+};
+
+class TcpTransport : public Transport {
+public:
+  TcpTransport(JsonRpcServer &server, int port, Framing framing, size_t loops) : connector(server, port, framing, loops), framing(framing) {
+    if (!connector.StartListening())
+      throw runtime_error("cannot listen on port " + to_string(port) + ": " + strerror(errno));
+  }
+  unique_ptr<IClientConnector> Connect() override { return make_unique<TcpClientConnector>("127.0.0.1", connector.Port(), framing); }
+
+private:
+  EpollServerConnector connector;
+  Framing framing;
+};
+
+class UringTransport : public Transport {
+public:
+  UringTransport(JsonRpcServer &server, int port, Framing framing, size_t loops) : connector(server, port, framing, loops), framing(framing) {
+    if (!connector.StartListening())
+      throw runtime_error("cannot listen on port " + to_string(port) + ": " + strerror(errno));
+  }
+  unique_ptr<IClientConnector> Connect() override { return make_unique<TcpClientConnector>("127.0.0.1", connector.Port(), framing); }
+  json Statistics(JsonRpc2Server &server) override {
+    json result = server.Statistics();
+    result["transport"] = connector.Statistics();
+    return result;
+  }
+
+private:
+  UringServerConnector connector;
+  Framing framing;
+};
+
+// Every client gets its own shared memory channel served by its own thread
+class ShmTransport : public Transport {
+public:
+  ShmTransport(JsonRpcServer &server, microseconds busyPoll) : server(server), busyPoll(busyPoll), channelMutex(), channels() {}
+  unique_ptr<IClientConnector> Connect() override {
+    lock_guard<std::mutex> lock(channelMutex);
+    string name = "/jsonrpc-loadgen-" + to_string(getpid()) + "-" + to_string(channels.size());
+    channels.push_back(make_unique<ShmServerConnector>(server, name, 1024 * 1024, busyPoll));
+    if (!channels.back()->StartListening())
+      throw runtime_error("cannot create shared memory channel " + name);
+    return make_unique<ShmClientConnector>(name, busyPoll);
+  }
+
+private:
+  JsonRpcServer &server;
+  microseconds busyPoll;
+  std::mutex channelMutex;
+  vector<unique_ptr<ShmServerConnector>> channels;
+};
+
+// One server replica per shard, built by setup; the server passed to MakeTransport stays idle
+class ShardedTransport : public Transport {
+public:
+  ShardedTransport(const ShardedTcpServer::ShardSetup &setup, int port, Framing framing, size_t shards)
+      : server(setup, port, framing, shards), framing(framing) {
+    if (!server.StartListening())
+      throw runtime_error("cannot listen on port " + to_string(port) + ": " + strerror(errno));
+  }
+  unique_ptr<IClientConnector> Connect() override { return make_unique<TcpClientConnector>("127.0.0.1", server.Port(), framing); }
+  json Statistics(JsonRpc2Server &) override { return server.Statistics(); }
+
+private:
+  ShardedTcpServer server;
+  Framing framing;
+};
+
+static unique_ptr<Transport> MakeTransport(const Options &options, JsonRpcServer &server, const ShardedTcpServer::ShardSetup &setup) {
+  Framing framing = options.framing == "length" ? Framing::length_prefixed : Framing::newline;
+  if (options.transport == "inmemory" || options.transport == "direct")
+    return make_unique<InMemoryTransport>(server, options.transport == "direct");
+  if (options.transport == "http")
+    return make_unique<HttpTransport>(server, options.port, options.httpPool, options.compress);
+  if (options.transport == "tcp")
+    return make_unique<TcpTransport>(server, options.port, framing, options.loops);
+  if (options.transport == "uring")
+    return make_unique<UringTransport>(server, options.port, framing, options.loops);
+  if (options.transport == "shm")
+    return make_unique<ShmTransport>(server, microseconds(options.busyPoll));
+  if (options.transport == "sharded")
+    return make_unique<ShardedTransport>(setup, options.port, framing, options.shards);
+  throw invalid_argument("unknown transport: " + options.transport);
+}
+
+static Product MakeProduct(const string &id) {
+  Product p;
+  p.id = id;
+  p.price = 9.99;
+  p.name = "Product " + id;
+  p.cat = category::order;
+  return p;
+}
+
+// Generates the warehouse method mix for one worker.
+class Workload {
+public:
+  Workload(const Options &options, unsigned int seed) : options(options), rng(seed), total(0) {
+    for (const auto &m : options.mix)
+      total += m.second;
+  }
+
+  // Returns true if the call succeeded, false if the server answered with an error.
+  bool Next(JsonRpcClient &client) {
+    const string &method = Pick();
+    try {
+      if (method == "GetProduct") {
+        client.CallMethod<Product>(1, method, {RandomId(options.products)});
+      } else if (method == "AddProduct") {
+        // Bounded key space, so that AllProducts does not grow without limit
+        client.CallMethod<bool>(1, method, {MakeProduct(RandomId(2 * options.products))});
+      } else {
+        client.CallMethod<json>(1, method, {});
+      }
+      return true;
+    } catch (JsonRpcException &) {
+      return false;
+    }
+  }
+
+private:
+  const Options &options;
+  mt19937_64 rng;
+  unsigned int total;
+
+  const string &Pick() {
+    unsigned int r = uniform_int_distribution<unsigned int>(0, total - 1)(rng);
+    for (const auto &m : options.mix) {
+      if (r < m.second)
+        return m.first;
+      r -= m.second;
+    }
+    return options.mix.back().first;
+  }
+
+  string RandomId(unsigned int range) { return "p" + to_string(uniform_int_distribution<unsigned int>(0, max(range, 1u) - 1)(rng)); }
+};
+
+struct WorkerResult {
+  WorkerResult() : latencies(), ok(0), errors(0) {}
+  LatencyRecorder latencies;
+  uint64_t ok;
+  uint64_t errors;
+};
+
+static void RunClosedLoop(const Options &options, Transport &transport, vector<WorkerResult> &results) {
+  vector<thread> workers;
+  const auto end = steady_clock::now() + duration<double>(options.duration);
+  for (unsigned int t = 0; t < options.threads; t++) {
+    workers.emplace_back([&, t]() {
+      auto connector = transport.Connect();
+      JsonRpcClient client(*connector, version::v2);
+      Workload workload(options, t + 1);
+      WorkerResult &result = results[t];
+      while (steady_clock::now() < end) {
+        auto start = steady_clock::now();
+        bool ok = workload.Next(client);
+        result.latencies.Record(steady_clock::now() - start);
+        ok ? result.ok++ : result.errors++;
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+}
+
+static void RunOpenLoop(const Options &options, Transport &transport, vector<WorkerResult> &results) {
+  vector<thread> workers;
+  atomic<uint64_t> next(0);
+  const uint64_t count = static_cast<uint64_t>(options.rate * options.duration);
+  const duration<double> interval(1.0 / options.rate);
+  const auto start = steady_clock::now() + milliseconds(10);
+  for (unsigned int t = 0; t < options.threads; t++) {
+    workers.emplace_back([&, t]() {
+      auto connector = transport.Connect();
+      JsonRpcClient client(*connector, version::v2);
+      Workload workload(options, t + 1);
+      WorkerResult &result = results[t];
+      result.latencies.Reserve(count / options.threads + 1);
+      for (uint64_t i = next++; i < count; i = next++) {
+        auto intended = start + duration_cast<steady_clock::duration>(interval * static_cast<double>(i));
+        this_thread::sleep_until(intended);
+        bool ok = workload.Next(client);
+        result.latencies.Record(steady_clock::now() - intended);
+        ok ? result.ok++ : result.errors++;
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+}
+
+static vector<pair<string, unsigned int>> ParseMix(const string &spec) {
+  vector<pair<string, unsigned int>> mix;
+  stringstream ss(spec);
+  string item;
+  while (getline(ss, item, ',')) {
+    auto pos = item.find('=');
+    if (pos == string::npos)
+      throw invalid_argument("invalid mix entry: " + item);
+    mix.emplace_back(item.substr(0, pos), static_cast<unsigned int>(stoul(item.substr(pos + 1))));
+  }
+  return mix;
+}
+
+static void Usage() {
+  cerr << "usage: jsonrpc-loadgen [options]\n"
+       << "  --transport T               inmemory|direct|http|tcp|uring|sharded|shm, connector to drive the server through (default: inmemory)\n"
+       << "  --mode closed|open          closed loop or constant arrival rate (default: closed)\n"
+       << "  --threads N                 concurrent clients (default: 4)\n"
+       << "  --rate R                    requests per second in open mode (default: 1000)\n"
+       << "  --duration S                run time in seconds (default: 5)\n"
+       << "  --products N                products preloaded into the warehouse (default: 100)\n"
+       << "  --mix M=W,...               method mix (default: GetProduct=90,AddProduct=5,AllProducts=5)\n"
+       << "  --port P                    port for network transports (default: 8485)\n"
+       << "  --framing newline|length    message framing of the tcp, uring and sharded transports (default: newline)\n"
+       << "  --loops N                   event loops of the tcp and uring transports (default: 1)\n"
+       << "  --http-pool N               share N persistent connections between all http clients (default: 0, one connection per call)\n"
+       << "  --compress BYTES            http clients accept compressed responses and compress requests from BYTES on (default: 0, off)\n"
+       << "  --busy-poll US              spin before sleeping on shm channels (default: 0)\n"
+       << "  --shards N                  shards of the sharded transport, each pinned to a CPU (default: 0, one per CPU)\n"
+       << "  --cache-ttl MS              cache GetProduct results for MS milliseconds (default: 0, disabled)\n"
+       << "  --executor E                inline|pool|stealing, where the server runs handlers (default: inline)\n"
+       << "  --workers N                 threads of the server executor (default: 4)\n"
+       << "  --service-us US             extra time every handler sleeps, simulating backend calls (default: 0)\n"
+       << "  --max-in-flight N           reject calls beyond N running or queued ones (default: 0, unbounded)\n"
+       << "  --queue-target US           shed calls queued longer than the CoDel target (default: 0, disabled)\n";
+}
+
+static Options ParseOptions(int argc, char **argv) {
+  Options options;
+  options.mix = ParseMix("GetProduct=90,AddProduct=5,AllProducts=5");
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--help" || i + 1 >= argc) {
+      Usage();
+      exit(arg == "--help" ? 0 : 1);
+    }
+    string value = argv[++i];
+    if (arg == "--transport")
+      options.transport = value;
+    else if (arg == "--mode")
+      options.mode = value;
+    else if (arg == "--threads")
+      options.threads = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--rate")
+      options.rate = stod(value);
+    else if (arg == "--duration")
+      options.duration = stod(value);
+    else if (arg == "--products")
+      options.products = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--mix")
+      options.mix = ParseMix(value);
+    else if (arg == "--port")
+      options.port = stoi(value);
+    else if (arg == "--framing")
+      options.framing = value;
+    else if (arg == "--loops")
+      options.loops = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--http-pool")
+      options.httpPool = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--compress")
+      options.compress = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--busy-poll")
+      options.busyPoll = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--shards")
+      options.shards = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--cache-ttl")
+      options.cacheTtl = stoi(value);
+    else if (arg == "--executor")
+      options.executor = value;
+    else if (arg == "--workers")
+      options.workers = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--service-us")
+      options.serviceTime = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--max-in-flight")
+      options.maxInFlight = static_cast<unsigned int>(stoul(value));
+    else if (arg == "--queue-target")
+      options.queueTarget = static_cast<unsigned int>(stoul(value));
+    else {
+      Usage();
+      exit(1);
+    }
+  }
+  if (options.threads == 0 || options.mix.empty() || options.rate <= 0) {
+    Usage();
+    exit(1);
+  }
+  return options;
+}
+
+// Registers the warehouse methods backed by app and applies the server options
+static void Configure(JsonRpc2Server &rpcServer, WarehouseServer &app, const Options &options) {
+  if (options.executor == "pool")
+    rpcServer.SetExecutor(make_shared<ThreadPoolExecutor>(options.workers));
+  else if (options.executor == "stealing")
+    rpcServer.SetExecutor(make_shared<WorkStealingExecutor>(options.workers));
+  rpcServer.SetMaxInFlight(options.maxInFlight);
+  rpcServer.SetQueueDelayTarget(microseconds(options.queueTarget));
+  auto backend = [service = microseconds(options.serviceTime)]() {
+    if (service.count() > 0)
+      this_thread::sleep_for(service);
+  };
+  rpcServer.Add("GetProduct", "Get a product by id", [&app, backend](const string &id) {
+    backend();
+    return app.GetProduct(id);
+  }, {"id"});
+  rpcServer.Add("AddProduct", "Add a product", [&app, backend](const Product &p) {
+    backend();
+    return app.AddProduct(p);
+  }, {"product"});
+  rpcServer.Add("AllProducts", "List all products", [&app, backend]() {
+    backend();
+    return app.AllProducts();
+  });
+  // WarehouseServer is not thread-safe, its methods share one strand
+  json metadata = {{"strand", "warehouse"}};
+  rpcServer.AddMethodMetadata("AddProduct", metadata);
+  rpcServer.AddMethodMetadata("AllProducts", metadata);
+  if (options.cacheTtl > 0)
+    metadata.update({{"cacheable", true}, {"ttl_ms", options.cacheTtl}, {"max_entries", options.products}});
+  rpcServer.AddMethodMetadata("GetProduct", metadata);
+  for (unsigned int i = 0; i < options.products; i++)
+    app.AddProduct(MakeProduct("p" + to_string(i)));
+}
+
+int main(int argc, char **argv) {
+  Options options = ParseOptions(argc, argv);
+
+  WarehouseServer app;
+  JsonRpc2Server rpcServer;
+  Configure(rpcServer, app, options);
+  // The sharded transport serves every shard from its own replica of the warehouse
+  vector<unique_ptr<WarehouseServer>> replicas;
+  auto setup = [&replicas, &options](JsonRpc2Server &server, size_t) {
+    replicas.push_back(make_unique<WarehouseServer>());
+    Configure(server, *replicas.back(), options);
+  };
+
+  auto transport = MakeTransport(options, rpcServer, setup);
+  vector<WorkerResult> results(options.threads);
+
+  auto start = steady_clock::now();
+  if (options.mode == "open")
+    RunOpenLoop(options, *transport, results);
+  else
+    RunClosedLoop(options, *transport, results);
+  double elapsed = duration<double>(steady_clock::now() - start).count();
+
+  WorkerResult total;
+  for (const auto &r : results) {
+    total.latencies.Merge(r.latencies);
+    total.ok += r.ok;
+    total.errors += r.errors;
+  }
+  total.latencies.Finish();
+
+  cout << fixed << setprecision(1);
+  cout << "transport:   " << options.transport << "\n"
+       << "mode:        " << options.mode << (options.mode == "open" ? " (" + to_string(static_cast<long>(options.rate)) + " req/s offered)" : "") << "\n"
+       << "threads:     " << options.threads << "\n"
+       << "requests:    " << total.latencies.Count() << " (" << total.errors << " errors)\n"
+       << "throughput:  " << static_cast<double>(total.latencies.Count()) / elapsed << " req/s\n"
+       << "goodput:     " << static_cast<double>(total.ok) / elapsed << " req/s\n"
+       << "server:      " << transport->Statistics(rpcServer).dump() << "\n"
+       << "latency us:  p50=" << total.latencies.Percentile(50) / 1000 << " p99=" << total.latencies.Percentile(99) / 1000
+       << " p99.9=" << total.latencies.Percentile(99.9) / 1000 << " max=" << total.latencies.Max() / 1000 << "\n";
+  return 0;
+}
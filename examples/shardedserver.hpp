@@ -0,0 +1,114 @@
+#pragma once
+#include "epollconnector.hpp"
+#include <functional>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Shard-per-core TCP runtime: every shard owns a JsonRpc2Server built by the setup function, a
+// listening socket bound with SO_REUSEPORT (the kernel spreads connections over them) and an event
+// loop pinned to one CPU. Nothing is shared between shards on the request path, so handlers and
+// their state should be per shard as well; setup receives the shard index for that.
+class ShardedTcpServer {
+public:
+  typedef std::function<void(jsonrpccxx::JsonRpc2Server &server, size_t shard)> ShardSetup;
+
+  // shards == 0 starts one shard per CPU the process may run on. Port 0 picks a free port, see Port().
+  ShardedTcpServer(ShardSetup setup, int port, Framing framing = Framing::newline, size_t shards = 0, std::string address = "127.0.0.1", bool pin = true)
+      : port(port), framing(framing), address(std::move(address)), pin(pin), cpus(AllowedCpus()), shards() {
+    size_t count = shards == 0 ? cpus.size() : shards;
+    for (size_t i = 0; i < count; i++) {
+      this->shards.push_back(std::make_unique<Shard>());
+      setup(this->shards.back()->server, i);
+    }
+  }
+
+  virtual ~ShardedTcpServer() { StopListening(); }
+
+  ShardedTcpServer(const ShardedTcpServer &) = delete;
+  ShardedTcpServer &operator=(const ShardedTcpServer &) = delete;
+
+  // Returns false if already listening or a shard cannot bind
+  bool StartListening() {
+    if (shards.front()->listenFd >= 0)
+      return false;
+    for (size_t i = 0; i < shards.size(); i++) {
+      Shard &shard = *shards[i];
+      shard.listenFd = tcp::Listen(address, port, true);
+      if (shard.listenFd < 0) {
+        StopListening();
+        return false;
+      }
+      // Later shards join the port the first one got
+      port = tcp::LocalPort(shard.listenFd);
+      shard.loop = std::make_unique<EpollEventLoop>(shard.server, framing, shard.listenFd);
+      if (pin && !cpus.empty()) {
+        int cpu = cpus[i % cpus.size()];
+        shard.loop->SetSetup([cpu]() { PinTo(cpu); });
+      }
+    }
+    for (auto &shard : shards)
+      shard->loop->Start();
+    return true;
+  }
+
+  void StopListening() {
+    for (auto &shard : shards) {
+      shard->loop.reset();
+      if (shard->listenFd >= 0)
+        close(shard->listenFd);
+      shard->listenFd = -1;
+    }
+  }
+
+  int Port() const { return port; }
+  size_t Shards() const { return shards.size(); }
+  jsonrpccxx::JsonRpc2Server &Server(size_t shard) { return shards.at(shard)->server; }
+
+  // Statistics() of every shard
+  jsonrpccxx::json Statistics() {
+    jsonrpccxx::json result = jsonrpccxx::json::array();
+    for (auto &shard : shards)
+      result.push_back(shard->server.Statistics());
+    return result;
+  }
+
+private:
+  struct Shard {
+    Shard() : server(), listenFd(-1), loop() {}
+    jsonrpccxx::JsonRpc2Server server;
+    int listenFd;
+    std::unique_ptr<EpollEventLoop> loop;
+  };
+
+  int port;
+  Framing framing;
+  std::string address;
+  bool pin;
+  std::vector<int> cpus;
+  std::vector<std::unique_ptr<Shard>> shards;
+
+  static std::vector<int> AllowedCpus() {
+    std::vector<int> result;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &set))
+          result.push_back(cpu);
+    }
+    if (result.empty())
+      result.push_back(0);
+    return result;
+  }
+
+  static void PinTo(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+};
@@ -0,0 +1,384 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <jsonrpccxx/iclientconnector.hpp>
+#include <jsonrpccxx/server.hpp>
+#include <linux/futex.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+// Same-host transport over a POSIX shared memory object holding two single-producer/single-consumer
+// rings, one for requests and one for responses. Waiting sides optionally spin for a while and then
+// sleep on a futex in the shared region, so a round trip costs no copies through the kernel and no
+// syscalls at all while both sides are busy. One channel serves one client connector at a time,
+// which claims it on construction; every request is answered with exactly one response, an empty
+// one for notifications.
+//
+// The server parses requests in place in the ring and copies the segments of its response straight
+// into the response ring. The client copies its request into the ring and the response out of it,
+// as IClientConnector deals in std::string.
+
+namespace shm {
+  // Futex based wake-up, usable across processes
+  struct Event {
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> waiters;
+  };
+
+  inline void Notify(Event &event) {
+    if (event.waiters.load() == 0)
+      return;
+    event.sequence.fetch_add(1);
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&event.sequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+  // Returns once ready() holds. Spins for spin first; sleeps are bounded so that a peer that went
+  // away without notifying is noticed through ready() as well.
+  template <typename Ready>
+  void Wait(Event &event, Ready ready, std::chrono::microseconds spin) {
+    auto spinUntil = std::chrono::steady_clock::now() + spin;
+    while (!ready()) {
+      if (spin.count() > 0 && std::chrono::steady_clock::now() < spinUntil)
+        continue;
+      uint32_t sequence = event.sequence.load();
+      event.waiters.fetch_add(1);
+      if (!ready()) {
+        timespec timeout{0, 100 * 1000 * 1000};
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&event.sequence), FUTEX_WAIT, sequence, &timeout, nullptr, 0);
+      }
+      event.waiters.fetch_sub(1);
+    }
+  }
+
+  struct alignas(64) RingControl {
+    // Byte offsets that only grow, written by the consumer and the producer respectively
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    Event readable;
+    Event writable;
+  };
+
+  // Records are a 4 byte length followed by the message, padded to 8 bytes. A record never wraps
+  // around the end of the buffer; a length of wrapMarker tells the consumer to continue at offset 0.
+  class Ring {
+  public:
+    Ring(RingControl *control, char *data, uint64_t capacity) : control(control), data(data), capacity(capacity), next(0) {}
+    Ring(const Ring &) = default;
+    Ring &operator=(const Ring &) = default;
+
+    RingControl &Control() { return *control; }
+    bool Empty() const { return control->head.load() == control->tail.load(); }
+    // Largest message that can ever be written
+    size_t MaxMessage() const { return capacity / 2 - headerSize; }
+
+    // Returns false if there is not enough free space
+    bool TryWrite(std::string_view message) {
+      return TryWriteRecord(message.size(), [message](char *out) { std::memcpy(out, message.data(), message.size()); });
+    }
+
+    // Writes the segments one after another into a single record
+    bool TryWriteSegments(const jsonrpccxx::ResponseBuffer &message) {
+      return TryWriteRecord(message.Size(), [&message](char *out) {
+        for (std::string_view segment : message.Segments()) {
+          std::memcpy(out, segment.data(), segment.size());
+          out += segment.size();
+        }
+      });
+    }
+
+    // Returns a view of the oldest message in place, or false if the ring is empty. The message
+    // stays valid and keeps its space until Pop().
+    bool Peek(std::string_view &message) {
+      uint64_t head = control->head.load(std::memory_order_relaxed);
+      if (head == control->tail.load(std::memory_order_acquire))
+        return false;
+      uint64_t offset = head % capacity;
+      uint32_t length = Load(offset);
+      if (length == wrapMarker) {
+        head += capacity - offset;
+        offset = 0;
+        length = Load(0);
+      }
+      message = std::string_view(data + offset + headerSize, length);
+      next = head + RecordSize(length);
+      return true;
+    }
+    void Pop() { control->head.store(next); }
+
+    // Returns false if the ring is empty, reuses the capacity of message
+    bool TryRead(std::string &message) {
+      std::string_view view;
+      if (!Peek(view))
+        return false;
+      message.assign(view.data(), view.size());
+      Pop();
+      return true;
+    }
+
+  private:
+    static constexpr uint32_t wrapMarker = 0xffffffff;
+    static constexpr uint64_t headerSize = 4;
+
+    RingControl *control;
+    char *data;
+    uint64_t capacity;
+    // Consumer: head behind the message returned by Peek()
+    uint64_t next;
+
+    // Producer side of TryWrite and TryWriteSegments, fill copies length bytes to the pointer it is given
+    template <typename Fill>
+    bool TryWriteRecord(size_t length, Fill fill) {
+      uint64_t tail = control->tail.load(std::memory_order_relaxed);
+      uint64_t head = control->head.load(std::memory_order_acquire);
+      uint64_t size = RecordSize(length);
+      uint64_t offset = tail % capacity;
+      uint64_t skip = offset + size > capacity ? capacity - offset : 0;
+      if (capacity - (tail - head) < skip + size)
+        return false;
+      if (skip > 0) {
+        Store(offset, wrapMarker);
+        offset = 0;
+      }
+      Store(offset, static_cast<uint32_t>(length));
+      fill(data + offset + headerSize);
+      control->tail.store(tail + skip + size);
+      return true;
+    }
+
+    static uint64_t RecordSize(size_t size) { return (headerSize + size + 7) & ~uint64_t(7); }
+    void Store(uint64_t offset, uint32_t value) { std::memcpy(data + offset, &value, sizeof(value)); }
+    uint32_t Load(uint64_t offset) const {
+      uint32_t value;
+      std::memcpy(&value, data + offset, sizeof(value));
+      return value;
+    }
+  };
+
+  struct Layout {
+    static constexpr uint32_t magic = 0x4a525043;
+    // Set to magic once the creator initialized everything else
+    std::atomic<uint32_t> tag;
+    uint64_t capacity;
+    std::atomic<uint32_t> closed;
+    // Set while a client connector uses the channel, the rings have room for one producer and one
+    // consumer each
+    std::atomic<uint32_t> claimed;
+    RingControl requests;
+    RingControl responses;
+  };
+
+  // Maps a shared memory object; the creator initializes it and unlinks the name again on destruction
+  class Region {
+  public:
+    // Creates name (e.g. "/myservice") with rings of capacity bytes each, rounded up to 8
+    static Region Create(const std::string &name, size_t capacity) {
+      capacity = (capacity + 7) & ~size_t(7);
+      int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+      if (fd < 0)
+        throw std::runtime_error("shm_open " + name + ": " + std::strerror(errno));
+      size_t size = sizeof(Layout) + 2 * capacity;
+      if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("ftruncate " + name + ": " + std::strerror(errno));
+      }
+      Region region(name, fd, size, true);
+      Layout *layout = new (region.memory) Layout{{0}, capacity, {0}, {0}, {}, {}};
+      layout->tag.store(Layout::magic, std::memory_order_release);
+      return region;
+    }
+
+    // Waits up to timeout for a channel that is still being created to be sized and initialized
+    static Region Open(const std::string &name, std::chrono::milliseconds timeout = std::chrono::seconds(1)) {
+      auto deadline = std::chrono::steady_clock::now() + timeout;
+      int fd = shm_open(name.c_str(), O_RDWR, 0600);
+      if (fd < 0)
+        throw std::runtime_error("cannot open shared memory " + name);
+      struct stat info;
+      while (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) < sizeof(Layout) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Layout)) {
+        close(fd);
+        throw std::runtime_error("cannot open shared memory " + name);
+      }
+      Region region(name, fd, static_cast<size_t>(info.st_size), false);
+      while (region.layout().tag.load(std::memory_order_acquire) != Layout::magic && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      if (region.layout().tag.load(std::memory_order_acquire) != Layout::magic || sizeof(Layout) + 2 * region.layout().capacity != region.size)
+        throw std::runtime_error("invalid shared memory channel " + name);
+      return region;
+    }
+
+    Region(Region &&other) noexcept : name(std::move(other.name)), fd(other.fd), size(other.size), owner(other.owner), memory(other.memory) {
+      other.fd = -1;
+      other.memory = nullptr;
+    }
+    Region(const Region &) = delete;
+    Region &operator=(const Region &) = delete;
+    Region &operator=(Region &&) = delete;
+
+    ~Region() {
+      if (memory != nullptr)
+        munmap(memory, size);
+      if (fd >= 0)
+        close(fd);
+      if (owner && fd >= 0)
+        shm_unlink(name.c_str());
+    }
+
+    Layout &layout() { return *static_cast<Layout *>(memory); }
+    Ring Requests() { return Ring(&layout().requests, static_cast<char *>(memory) + sizeof(Layout), layout().capacity); }
+    Ring Responses() { return Ring(&layout().responses, static_cast<char *>(memory) + sizeof(Layout) + layout().capacity, layout().capacity); }
+
+  private:
+    Region(std::string name, int fd, size_t size, bool owner) : name(std::move(name)), fd(fd), size(size), owner(owner), memory(nullptr) {
+      memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (memory == MAP_FAILED) {
+        close(fd);
+        if (owner)
+          shm_unlink(this->name.c_str());
+        throw std::runtime_error("mmap " + this->name + ": " + std::strerror(errno));
+      }
+    }
+
+    std::string name;
+    int fd;
+    size_t size;
+    bool owner;
+    void *memory;
+  };
+} // namespace shm
+
+// Serves one shared memory channel from a dedicated thread
+class ShmServerConnector {
+public:
+  ShmServerConnector(jsonrpccxx::JsonRpcServer &server, std::string name, size_t capacity = 1024 * 1024,
+                     std::chrono::microseconds busyPoll = std::chrono::microseconds(0))
+      : server(server), name(std::move(name)), capacity(capacity), busyPoll(busyPoll), region(), stopping(false), thread() {}
+
+  virtual ~ShmServerConnector() { StopListening(); }
+
+  ShmServerConnector(const ShmServerConnector &) = delete;
+  ShmServerConnector &operator=(const ShmServerConnector &) = delete;
+
+  // Returns false if already listening or the channel cannot be created (e.g. the name exists)
+  bool StartListening() {
+    if (region)
+      return false;
+    try {
+      region = std::make_unique<shm::Region>(shm::Region::Create(name, capacity));
+    } catch (std::exception &) {
+      return false;
+    }
+    stopping = false;
+    thread = std::thread([this]() { Run(); });
+    return true;
+  }
+
+  void StopListening() {
+    if (!region)
+      return;
+    stopping = true;
+    region->layout().closed = 1;
+    shm::Notify(region->layout().requests.readable);
+    shm::Notify(region->layout().responses.readable);
+    thread.join();
+    region.reset();
+  }
+
+private:
+  jsonrpccxx::JsonRpcServer &server;
+  std::string name;
+  size_t capacity;
+  std::chrono::microseconds busyPoll;
+  std::unique_ptr<shm::Region> region;
+  std::atomic<bool> stopping;
+  std::thread thread;
+
+  void Run() {
+    shm::Ring requests = region->Requests();
+    shm::Ring responses = region->Responses();
+    std::string_view request;
+    while (!stopping) {
+      if (!requests.Peek(request)) {
+        shm::Wait(requests.Control().readable, [&]() { return stopping || !requests.Empty(); }, busyPoll);
+        continue;
+      }
+      jsonrpccxx::ResponseBuffer response = server.HandleBuffer(request);
+      requests.Pop();
+      shm::Notify(requests.Control().writable);
+      if (response.Size() > responses.MaxMessage())
+        response = jsonrpccxx::json{{"jsonrpc", "2.0"}, {"id", nullptr}, {"error", {{"code", jsonrpccxx::internal_error}, {"message", "response too large"}}}}.dump();
+      while (!stopping && !responses.TryWriteSegments(response))
+        shm::Wait(responses.Control().writable, [&]() { return stopping || responses.Empty(); }, busyPoll);
+      shm::Notify(responses.Control().readable);
+    }
+  }
+};
+
+// Client end of a channel created by ShmServerConnector, one call at a time. Only one connector can
+// use a channel at once, a second one fails to open it until the first one is destroyed.
+class ShmClientConnector : public jsonrpccxx::IClientConnector {
+public:
+  explicit ShmClientConnector(const std::string &name, std::chrono::microseconds busyPoll = std::chrono::microseconds(0))
+      : region(Open(name)), requests(region.Requests()), responses(region.Responses()), busyPoll(busyPoll), response() {
+    uint32_t unclaimed = 0;
+    if (!region.layout().claimed.compare_exchange_strong(unclaimed, 1))
+      throw jsonrpccxx::JsonRpcException(-32003, "client connector error, shared memory channel " + name + " is in use");
+  }
+
+  ~ShmClientConnector() override { region.layout().claimed.store(0); }
+
+  ShmClientConnector(const ShmClientConnector &) = delete;
+  ShmClientConnector &operator=(const ShmClientConnector &) = delete;
+
+  std::string Send(const std::string &request) override {
+    SendInto(request, response);
+    return response;
+  }
+
+  // Reads the response straight from the ring into the caller's buffer
+  void SendInto(const std::string &request, std::string &received) override {
+    if (request.size() > requests.MaxMessage())
+      throw jsonrpccxx::JsonRpcException(-32003, "client connector error, request too large");
+    while (!requests.TryWrite(request)) {
+      shm::Wait(requests.Control().writable, [this]() { return Closed() || requests.Empty(); }, busyPoll);
+      if (Closed())
+        throw jsonrpccxx::JsonRpcException(-32003, "client connector error, channel closed");
+    }
+    shm::Notify(requests.Control().readable);
+    shm::Wait(responses.Control().readable, [this]() { return Closed() || !responses.Empty(); }, busyPoll);
+    if (!responses.TryRead(received))
+      throw jsonrpccxx::JsonRpcException(-32003, "client connector error, channel closed");
+    shm::Notify(responses.Control().writable);
+  }
+
+private:
+  shm::Region region;
+  shm::Ring requests;
+  shm::Ring responses;
+  std::chrono::microseconds busyPoll;
+  std::string response;
+
+  bool Closed() { return region.layout().closed.load() != 0; }
+
+  static shm::Region Open(const std::string &name) {
+    try {
+      return shm::Region::Open(name);
+    } catch (std::exception &e) {
+      throw jsonrpccxx::JsonRpcException(-32003, std::string("client connector error, ") + e.what());
+    }
+  }
+};
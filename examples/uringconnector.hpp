@@ -0,0 +1,653 @@
+#pragma once
+#include "epollconnector.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <jsonrpccxx/server.hpp>
+#include <linux/io_uring.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// TCP transport on io_uring, speaking the same framing as EpollServerConnector. A loop keeps one
+// multishot accept and one multishot receive per connection armed; received bytes land in a ring of
+// buffers registered with the kernel, so the steady state needs no per-read submissions at all.
+// Everything queued while handling a batch of completions (sends, re-arms) goes to the kernel with
+// the next wait in a single io_uring_enter. Kernels without the needed features (before 6.0) or
+// sandboxes that block io_uring get the epoll loop instead, see UringServerConnector::Engine().
+
+namespace uring {
+  inline int Setup(unsigned entries, io_uring_params &params) { return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params)); }
+  inline int Enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+  }
+  inline int Register(int fd, unsigned opcode, void *arg, unsigned count) { return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count)); }
+
+  // Submission and completion queues of one io_uring instance, used from a single thread
+  class Ring {
+  public:
+    explicit Ring(unsigned entries)
+        : fd(-1), params(), memory(MAP_FAILED), memorySize(0), sqes(static_cast<io_uring_sqe *>(MAP_FAILED)), sqesSize(0), sqHead(nullptr),
+          sqTail(nullptr), sqMask(0), sqArray(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr), tail(0), submitted(0), enters(0) {
+      std::memset(&params, 0, sizeof(params));
+      fd = Setup(entries, params);
+      if (fd < 0)
+        throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+      if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        close(fd);
+        throw std::runtime_error("io_uring lacks required features");
+      }
+      memorySize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+      memory = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+      sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+      sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+      if (memory == MAP_FAILED || sqes == MAP_FAILED) {
+        int error = errno;
+        Release();
+        throw std::runtime_error(std::string("io_uring mmap failed: ") + std::strerror(error));
+      }
+      char *base = static_cast<char *>(memory);
+      sqHead = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+      sqTail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+      sqMask = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+      sqArray = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+      cqHead = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+      cqTail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+      cqMask = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+      cqes = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+      tail = submitted = *sqTail;
+    }
+
+    ~Ring() { Release(); }
+
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    int Fd() const { return fd; }
+    // io_uring_enter calls made so far
+    uint64_t Enters() const { return enters.load(std::memory_order_relaxed); }
+
+    // Returns a cleared entry to fill in; it is submitted with the next Submit()
+    io_uring_sqe &Prepare() {
+      if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == params.sq_entries)
+        Submit(0);
+      unsigned index = tail & sqMask;
+      io_uring_sqe &sqe = sqes[index];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqArray[index] = index;
+      tail++;
+      return sqe;
+    }
+
+    // Submits everything prepared and waits for at least wait completions, with one syscall
+    void Submit(unsigned wait) {
+      __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+      unsigned count = tail - submitted;
+      int result;
+      do {
+        enters.fetch_add(1, std::memory_order_relaxed);
+        result = Enter(fd, count, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0);
+      } while (result < 0 && errno == EINTR);
+      if (result > 0)
+        submitted += static_cast<unsigned>(result);
+    }
+
+    // Calls handler for every completion available
+    template <typename Handler>
+    void Complete(Handler handler) {
+      unsigned head = *cqHead;
+      unsigned end = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+      for (; head != end; head++)
+        handler(cqes[head & cqMask]);
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+  private:
+    int fd;
+    io_uring_params params;
+    void *memory;
+    size_t memorySize;
+    io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    io_uring_cqe *cqes;
+    // Prepared up to tail, handed to the kernel up to submitted
+    unsigned tail;
+    unsigned submitted;
+    std::atomic<uint64_t> enters;
+
+    void Release() {
+      if (sqes != MAP_FAILED)
+        munmap(sqes, sqesSize);
+      if (memory != MAP_FAILED)
+        munmap(memory, memorySize);
+      if (fd >= 0)
+        close(fd);
+      sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+      memory = MAP_FAILED;
+      fd = -1;
+    }
+  };
+
+  // Receive buffers registered as provided buffer ring: the kernel picks one per completion and the
+  // loop hands it back as soon as the bytes are copied into the connection's frame decoder
+  class BufferRing {
+  public:
+    // count must be a power of two
+    BufferRing(Ring &ring, uint16_t group, unsigned count, size_t size)
+        : ring(ring), group(group), count(count), size(size), entries(MAP_FAILED), buffers(MAP_FAILED), tail(0) {
+      entries = mmap(nullptr, count * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      buffers = mmap(nullptr, count * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      io_uring_buf_reg reg;
+      std::memset(&reg, 0, sizeof(reg));
+      reg.ring_addr = reinterpret_cast<uint64_t>(entries);
+      reg.ring_entries = count;
+      reg.bgid = group;
+      if (entries == MAP_FAILED || buffers == MAP_FAILED || Register(ring.Fd(), IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        int error = errno;
+        Release();
+        throw std::runtime_error(std::string("io_uring buffer ring registration failed: ") + std::strerror(error));
+      }
+      for (unsigned i = 0; i < count; i++)
+        Recycle(static_cast<uint16_t>(i));
+    }
+
+    ~BufferRing() {
+      io_uring_buf_reg reg;
+      std::memset(&reg, 0, sizeof(reg));
+      reg.bgid = group;
+      Register(ring.Fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+      Release();
+    }
+
+    BufferRing(const BufferRing &) = delete;
+    BufferRing &operator=(const BufferRing &) = delete;
+
+    uint16_t Group() const { return group; }
+    const char *Buffer(uint16_t id) const { return static_cast<const char *>(buffers) + id * size; }
+
+    void Recycle(uint16_t id) {
+      io_uring_buf &entry = static_cast<io_uring_buf *>(entries)[tail & (count - 1)];
+      entry.addr = reinterpret_cast<uint64_t>(Buffer(id));
+      entry.len = static_cast<uint32_t>(size);
+      entry.bid = id;
+      tail++;
+      // The tail overlays the reserved field of the first entry
+      __atomic_store_n(&static_cast<io_uring_buf *>(entries)[0].resv, tail, __ATOMIC_RELEASE);
+    }
+
+  private:
+    Ring &ring;
+    uint16_t group;
+    unsigned count;
+    size_t size;
+    void *entries;
+    void *buffers;
+    uint16_t tail;
+
+    void Release() {
+      if (entries != MAP_FAILED)
+        munmap(entries, count * sizeof(io_uring_buf));
+      if (buffers != MAP_FAILED)
+        munmap(buffers, count * size);
+      entries = buffers = MAP_FAILED;
+    }
+  };
+
+  // True if this kernel supports everything UringEventLoop uses. Multishot receive (6.0) cannot be
+  // probed for, so the kernel version stands in for it.
+  inline bool Supported() {
+    static const bool supported = []() {
+      utsname name;
+      int major = 0, minor = 0;
+      if (uname(&name) != 0 || std::sscanf(name.release, "%d.%d", &major, &minor) != 2 || major < 6)
+        return false;
+      try {
+        Ring ring(8);
+        std::vector<char> memory(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto *probe = reinterpret_cast<io_uring_probe *>(memory.data());
+        if (Register(ring.Fd(), IORING_REGISTER_PROBE, probe, 256) != 0)
+          return false;
+        for (int op : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_READ})
+          if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            return false;
+        BufferRing buffers(ring, 0, 8, 4096);
+        return true;
+      } catch (std::exception &) {
+        return false;
+      }
+    }();
+    return supported;
+  }
+} // namespace uring
+
+// One io_uring loop serving the connections it accepted from a shared listening socket
+class UringEventLoop {
+public:
+  // Throws std::runtime_error if the ring cannot be set up
+  UringEventLoop(jsonrpccxx::JsonRpcServer &server, Framing framing, int listenFd, unsigned entries = 1024, unsigned bufferCount = 256,
+                 size_t bufferSize = 16 * 1024)
+      : server(server), framing(framing), listenFd(listenFd), ring(entries), buffers(ring, 0, bufferCount, bufferSize), mailbox(std::make_shared<tcp::Mailbox>()),
+        wakeValue(0), connections(), dirty(), nextId(1), armed(0), requests(0), stopping(false), setup(), thread() {
+    if (mailbox->eventFd < 0)
+      throw std::runtime_error(std::string("eventfd failed: ") + std::strerror(errno));
+    // Reads of the eventfd are submitted to the ring and must park there instead of failing
+    fcntl(mailbox->eventFd, F_SETFL, fcntl(mailbox->eventFd, F_GETFL) & ~O_NONBLOCK);
+  }
+
+  ~UringEventLoop() {
+    Stop();
+    for (auto &connection : connections)
+      close(connection.second->fd);
+  }
+
+  UringEventLoop(const UringEventLoop &) = delete;
+  UringEventLoop &operator=(const UringEventLoop &) = delete;
+
+  void Start() {
+    thread = std::thread([this]() { Run(); });
+  }
+
+  // Responses completing afterwards are dropped
+  void Stop() {
+    if (!thread.joinable())
+      return;
+    stopping = true;
+    mailbox->Close();
+    thread.join();
+  }
+
+  // Runs setup on the loop thread before it serves connections, e.g. to pin it to a CPU
+  void SetSetup(std::function<void()> setup) { this->setup = std::move(setup); }
+
+  uint64_t Enters() const { return ring.Enters(); }
+  uint64_t Requests() const { return requests.load(std::memory_order_relaxed); }
+
+private:
+  enum class Operation : uint64_t { accept = 1, receive, send, wake, cancel };
+
+  struct Connection {
+    Connection(int fd, Framing framing)
+        : fd(fd), scope(jsonrpccxx::NewRequestScope()), in(framing), out(), sending(), sent(0), outstanding(0), readClosed(false), sendPending(false), closed(false),
+          queued(false) {}
+    int fd;
+    // rpc.cancel on this connection only reaches its own calls
+    jsonrpccxx::RequestScope scope;
+    FrameDecoder in;
+    // Responses collected while a send is in flight
+    std::string out;
+    // Owned by the kernel until the send completes
+    std::string sending;
+    size_t sent;
+    // Requests handed to the server and not answered yet
+    size_t outstanding;
+    bool readClosed;
+    bool sendPending;
+    // Shut down, erased once no send is pending
+    bool closed;
+    // Listed in dirty
+    bool queued;
+  };
+
+  static constexpr unsigned operationShift = 56;
+
+  jsonrpccxx::JsonRpcServer &server;
+  Framing framing;
+  int listenFd;
+  uring::Ring ring;
+  uring::BufferRing buffers;
+  std::shared_ptr<tcp::Mailbox> mailbox;
+  uint64_t wakeValue;
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+  // Connections with responses to send at the end of the current iteration
+  std::vector<uint64_t> dirty;
+  uint64_t nextId;
+  // Operations the kernel has not posted the last completion of yet
+  size_t armed;
+  std::atomic<uint64_t> requests;
+  std::atomic<bool> stopping;
+  std::function<void()> setup;
+  std::thread thread;
+
+  inline static thread_local UringEventLoop *current = nullptr;
+
+  static uint64_t Tag(Operation operation, uint64_t id) { return static_cast<uint64_t>(operation) << operationShift | id; }
+
+  void Run() {
+    current = this;
+    if (setup)
+      setup();
+    ArmAccept();
+    ArmWake();
+    while (!stopping) {
+      ring.Submit(1);
+      ring.Complete([this](const io_uring_cqe &cqe) { Handle(cqe); });
+      FlushDirty();
+    }
+    Drain();
+  }
+
+  // The kernel still writes into wakeValue and reads the send buffers of armed operations, so they
+  // are cancelled and their completions reaped before the loop's members go away
+  void Drain() {
+    io_uring_sqe &sqe = ring.Prepare();
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = -1;
+    sqe.cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe.user_data = Tag(Operation::cancel, 0);
+    armed++;
+    // Shut down sockets as well, in case an operation was already past the point of cancelling
+    for (auto &connection : connections)
+      shutdown(connection.second->fd, SHUT_RDWR);
+    mailbox->Wake();
+    while (armed > 0) {
+      ring.Submit(1);
+      ring.Complete([this](const io_uring_cqe &cqe) {
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+          armed--;
+      });
+    }
+  }
+
+  void ArmAccept() {
+    io_uring_sqe &sqe = ring.Prepare();
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = listenFd;
+    sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe.accept_flags = SOCK_CLOEXEC;
+    sqe.user_data = Tag(Operation::accept, 0);
+    armed++;
+  }
+
+  void ArmWake() {
+    io_uring_sqe &sqe = ring.Prepare();
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = mailbox->eventFd;
+    sqe.addr = reinterpret_cast<uint64_t>(&wakeValue);
+    sqe.len = sizeof(wakeValue);
+    sqe.user_data = Tag(Operation::wake, 0);
+    armed++;
+  }
+
+  void ArmReceive(uint64_t id, int fd) {
+    io_uring_sqe &sqe = ring.Prepare();
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = fd;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = buffers.Group();
+    sqe.user_data = Tag(Operation::receive, id);
+    armed++;
+  }
+
+  void ArmSend(uint64_t id, Connection &connection) {
+    io_uring_sqe &sqe = ring.Prepare();
+    sqe.opcode = IORING_OP_SEND;
+    sqe.fd = connection.fd;
+    sqe.addr = reinterpret_cast<uint64_t>(connection.sending.data() + connection.sent);
+    sqe.len = static_cast<uint32_t>(connection.sending.size() - connection.sent);
+    sqe.msg_flags = MSG_NOSIGNAL;
+    sqe.user_data = Tag(Operation::send, id);
+    connection.sendPending = true;
+    armed++;
+  }
+
+  void Handle(const io_uring_cqe &cqe) {
+    auto operation = static_cast<Operation>(cqe.user_data >> operationShift);
+    uint64_t id = cqe.user_data & ((uint64_t(1) << operationShift) - 1);
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+    if (!more)
+      armed--;
+    switch (operation) {
+    case Operation::accept:
+      if (cqe.res >= 0)
+        Accept(cqe.res);
+      if (!more && !stopping)
+        ArmAccept();
+      break;
+    case Operation::wake:
+      for (auto &response : mailbox->Take())
+        Deliver(response.first, std::move(response.second));
+      if (!stopping)
+        ArmWake();
+      break;
+    case Operation::receive:
+      Receive(id, cqe, more);
+      break;
+    case Operation::send:
+      Sent(id, cqe.res);
+      break;
+    case Operation::cancel:
+      break;
+    }
+  }
+
+  void Accept(int fd) {
+    tcp::SetNoDelay(fd);
+    uint64_t id = nextId++;
+    connections.emplace(id, std::make_unique<Connection>(fd, framing));
+    ArmReceive(id, fd);
+  }
+
+  void Receive(uint64_t id, const io_uring_cqe &cqe, bool more) {
+    auto found = connections.find(id);
+    Connection *connection = found == connections.end() || found->second->closed ? nullptr : found->second.get();
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      auto buffer = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      if (connection != nullptr && cqe.res > 0 && !connection->in.Failed()) {
+        auto size = static_cast<size_t>(cqe.res);
+        std::memcpy(connection->in.Reserve(size), buffers.Buffer(buffer), size);
+        connection->in.Commit(size);
+      }
+      buffers.Recycle(buffer);
+    }
+    if (connection == nullptr)
+      return;
+    if (cqe.res <= 0 && cqe.res != -ENOBUFS) {
+      connection->readClosed = true;
+      Queue(id, *connection);
+      return;
+    }
+    // The kernel ends a multishot receive when it ran out of buffers or for other transient reasons
+    if (!more)
+      ArmReceive(id, connection->fd);
+    std::string_view frame;
+    while (connection->in.Next(frame)) {
+      connection->outstanding++;
+      requests.fetch_add(1, std::memory_order_relaxed);
+      std::shared_ptr<tcp::Mailbox> box = mailbox;
+      server.HandleBufferAsync(
+          frame,
+          [this, box, id](jsonrpccxx::ResponseBuffer response) {
+            if (current == this)
+              Deliver(id, std::move(response));
+            else
+              box->Post(id, std::move(response));
+          },
+          connection->scope);
+    }
+    if (connection->in.Truncated()) {
+      // Multi-line JSON: the truncated line is answered with a parse error, then the connection closes
+      connection->readClosed = true;
+      Queue(id, *connection);
+    } else if (connection->in.Failed()) {
+      Close(id);
+    }
+  }
+
+  void Sent(uint64_t id, int result) {
+    auto found = connections.find(id);
+    if (found == connections.end())
+      return;
+    Connection &connection = *found->second;
+    connection.sendPending = false;
+    if (connection.closed || result <= 0) {
+      Close(id);
+      return;
+    }
+    connection.sent += static_cast<size_t>(result);
+    if (connection.sent < connection.sending.size()) {
+      ArmSend(id, connection);
+      return;
+    }
+    connection.sending.clear();
+    connection.sent = 0;
+    Queue(id, connection);
+  }
+
+  // The segments go straight into the send buffer, which is the one copy a single SEND needs
+  void Deliver(uint64_t id, jsonrpccxx::ResponseBuffer response) {
+    auto found = connections.find(id);
+    if (found == connections.end() || found->second->closed)
+      return;
+    Connection &connection = *found->second;
+    connection.outstanding--;
+    char header[4];
+    connection.out += FrameHeader(header, response.Size(), framing);
+    response.AppendTo(connection.out);
+    connection.out += FrameTrailer(framing);
+    Queue(id, connection);
+  }
+
+  void Queue(uint64_t id, Connection &connection) {
+    if (!connection.queued) {
+      connection.queued = true;
+      dirty.push_back(id);
+    }
+  }
+
+  // Starts one send per connection for everything answered during this iteration
+  void FlushDirty() {
+    for (uint64_t id : dirty) {
+      auto found = connections.find(id);
+      if (found == connections.end())
+        continue;
+      Connection &connection = *found->second;
+      connection.queued = false;
+      if (connection.sendPending)
+        continue;
+      if (!connection.out.empty()) {
+        connection.sending.swap(connection.out);
+        connection.out.clear();
+        ArmSend(id, connection);
+      } else if (connection.readClosed && connection.outstanding == 0) {
+        Close(id);
+      }
+    }
+    dirty.clear();
+  }
+
+  // Shuts the socket down, which also ends its pending receive; the connection goes away once the
+  // kernel no longer reads from its send buffer
+  void Close(uint64_t id) {
+    auto found = connections.find(id);
+    if (found == connections.end())
+      return;
+    Connection &connection = *found->second;
+    if (!connection.closed) {
+      connection.closed = true;
+      shutdown(connection.fd, SHUT_RDWR);
+    }
+    if (!connection.sendPending) {
+      close(connection.fd);
+      connections.erase(found);
+    }
+  }
+};
+
+// TCP server connector on io_uring loops, or on epoll loops where io_uring is not available
+class UringServerConnector {
+public:
+  // Port 0 picks a free port, see Port(). useUring = false forces the epoll loops.
+  explicit UringServerConnector(jsonrpccxx::JsonRpcServer &server, int port, Framing framing = Framing::newline, size_t loops = 1,
+                                std::string address = "127.0.0.1", bool useUring = true)
+      : server(server), port(port), framing(framing), loopCount(loops == 0 ? 1 : loops), address(std::move(address)), uring(useUring && uring::Supported()),
+        listenFd(-1), loops(), fallback() {}
+
+  virtual ~UringServerConnector() { StopListening(); }
+
+  UringServerConnector(const UringServerConnector &) = delete;
+  UringServerConnector &operator=(const UringServerConnector &) = delete;
+
+  // Returns false if already listening or the address cannot be bound
+  bool StartListening() {
+    if (listenFd >= 0 || fallback)
+      return false;
+    if (!uring) {
+      fallback = std::make_unique<EpollServerConnector>(server, port, framing, loopCount, address);
+      if (!fallback->StartListening()) {
+        fallback.reset();
+        return false;
+      }
+      port = fallback->Port();
+      return true;
+    }
+    listenFd = tcp::Listen(address, port);
+    if (listenFd < 0)
+      return false;
+    port = tcp::LocalPort(listenFd);
+    for (size_t i = 0; i < loopCount; i++)
+      loops.push_back(std::make_unique<UringEventLoop>(server, framing, listenFd));
+    for (auto &loop : loops)
+      loop->Start();
+    return true;
+  }
+
+  void StopListening() {
+    fallback.reset();
+    if (listenFd < 0)
+      return;
+    loops.clear();
+    close(listenFd);
+    listenFd = -1;
+  }
+
+  int Port() const { return port; }
+  // "io_uring" or "epoll"
+  std::string Engine() const { return uring ? "io_uring" : "epoll"; }
+
+  // Engine, and for io_uring the requests served and io_uring_enter calls made by all loops
+  jsonrpccxx::json Statistics() const {
+    jsonrpccxx::json result{{"engine", Engine()}};
+    if (uring) {
+      uint64_t enters = 0, requests = 0;
+      for (auto &loop : loops) {
+        enters += loop->Enters();
+        requests += loop->Requests();
+      }
+      result["requests"] = requests;
+      result["enters"] = enters;
+    }
+    return result;
+  }
+
+private:
+  jsonrpccxx::JsonRpcServer &server;
+  int port;
+  Framing framing;
+  size_t loopCount;
+  std::string address;
+  bool uring;
+  int listenFd;
+  std::vector<std::unique_ptr<UringEventLoop>> loops;
+  std::unique_ptr<EpollServerConnector> fallback;
+};
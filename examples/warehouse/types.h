@@ -1,5 +1,5 @@
 #pragma once
-#include <nlohmann/json.hpp>
+#include <jsonrpccxx/codec.hpp>
 
 enum class category { order, cash_carry };
 
@@ -12,18 +12,6 @@ public:
   category cat;
 };
 
-NLOHMANN_JSON_SERIALIZE_ENUM(category, {{category::order, "order"}, {category::cash_carry, "cc"}})
+JSONRPCCXX_ENUM(category, {category::order, "order"}, {category::cash_carry, "cc"})
 
-inline void to_json(nlohmann::json &j, const Product &p) {
-  j = nlohmann::json{{"id", p.id},
-		     {"price", p.price},
-		     {"name", p.name},
-		     {"category", p.cat}};
- }
-
-inline void from_json(const nlohmann::json &j, Product &p) {
-  j.at("name").get_to(p.name);
-  j.at("id").get_to(p.id);
-  j.at("price").get_to(p.price);
-  j.at("category").get_to(p.cat);
-}
+JSONRPCCXX_STRUCT(Product, JSONRPCCXX_FIELD(id), JSONRPCCXX_FIELD(price), JSONRPCCXX_FIELD(name), JSONRPCCXX_FIELD_AS(cat, "category"))
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "common.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace jsonrpccxx {
+  // Error code of calls rejected by admission control, from the implementation defined server error range
+  static constexpr int server_overloaded = -32000;
+  // Error code of calls whose deadline passed before their handler started
+  static constexpr int deadline_exceeded = -32001;
+  // Error code of calls cancelled through rpc.cancel
+  static constexpr int request_cancelled = -32002;
+
+  static inline JsonRpcException overloaded_exception(const std::string &reason) {
+    return JsonRpcException(server_overloaded, "server overloaded: " + reason);
+  }
+
+  // Bounds the number of calls admitted but not yet completed
+  class InFlightLimit {
+  public:
+    explicit InFlightLimit(size_t limit) : limit(std::max<size_t>(limit, 1)), inFlight(0), rejected(0) {}
+
+    bool TryAcquire() {
+      if (inFlight.fetch_add(1) >= limit) {
+        inFlight--;
+        rejected++;
+        return false;
+      }
+      return true;
+    }
+
+    void Release() { inFlight--; }
+
+    size_t Limit() const { return limit; }
+    size_t InFlight() const { return inFlight; }
+    size_t Rejected() const { return rejected; }
+
+  private:
+    const size_t limit;
+    std::atomic<size_t> inFlight;
+    std::atomic<size_t> rejected;
+  };
+
+  // Queue delay based shedding following CoDel: the server counts as overloaded while the smallest
+  // queue delay seen during the last interval exceeded the target. While overloaded, calls that
+  // waited longer than twice the target are shed, so standing queues drain instead of growing.
+  class QueueDelayShedder {
+  public:
+    typedef std::chrono::steady_clock clock;
+
+    QueueDelayShedder(std::chrono::microseconds target, std::chrono::microseconds interval)
+        : target(target), interval(interval), mutex(), intervalEnd(clock::now() + interval), minDelay(clock::duration::max()), overloaded(false),
+          shed(0) {}
+
+    // Called when a call is about to run after waiting for delay, returns true if it should be shed
+    bool ShouldShed(clock::duration delay) {
+      auto now = clock::now();
+      bool drop;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (now >= intervalEnd) {
+          overloaded = minDelay > target;
+          minDelay = delay;
+          intervalEnd = now + interval;
+        } else {
+          minDelay = std::min(minDelay, delay);
+        }
+        drop = overloaded && delay > 2 * target;
+      }
+      if (drop) {
+        shed++;
+      }
+      return drop;
+    }
+
+    bool Overloaded() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return overloaded;
+    }
+    size_t Shed() const { return shed; }
+
+  private:
+    const clock::duration target;
+    const clock::duration interval;
+    mutable std::mutex mutex;
+    clock::time_point intervalEnd;
+    clock::duration minDelay;
+    bool overloaded;
+    std::atomic<size_t> shed;
+  };
+} // namespace jsonrpccxx
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "client.hpp"
+#include "iclientconnector.hpp"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+
+namespace jsonrpccxx {
+  // Result of an asynchronous call: the "result" member of the response, or its error
+  typedef std::variant<json, JsonRpcException> CallResult;
+  typedef std::function<void(CallResult)> CallCallback;
+
+  // JSON-RPC 2.0 client for many outstanding calls over one IAsyncClientConnector. Ids are assigned
+  // automatically, responses are matched to their calls by id and may arrive in any order.
+  // All methods are thread-safe.
+  class AsyncJsonRpcClient {
+  public:
+    explicit AsyncJsonRpcClient(IAsyncClientConnector &connector) : connector(connector), nextId(1), mutex(), pending(), closed() {
+      connector.SetMessageHandler([this](const std::string &message) { HandleMessage(message); });
+    }
+
+    // Fails all calls that are still pending. The connector must not deliver messages afterwards.
+    virtual ~AsyncJsonRpcClient() {
+      connector.SetMessageHandler(nullptr);
+      FailPending(JsonRpcException(internal_error, "client destroyed before a response arrived"));
+    }
+
+    AsyncJsonRpcClient(const AsyncJsonRpcClient &) = delete;
+    AsyncJsonRpcClient &operator=(const AsyncJsonRpcClient &) = delete;
+
+    template <typename T>
+    std::future<T> CallMethodAsync(const std::string &name, const positional_parameter &params = {}) {
+      return call_future<T>(name, params);
+    }
+    template <typename T>
+    std::future<T> CallMethodNamedAsync(const std::string &name, const named_parameter &params = {}) {
+      return call_future<T>(name, params);
+    }
+
+    // callback runs on the thread delivering the response, or on the calling thread if sending failed
+    void CallMethodAsync(const std::string &name, const positional_parameter &params, CallCallback callback) { call_method(name, params, std::move(callback)); }
+    void CallMethodNamedAsync(const std::string &name, const named_parameter &params, CallCallback callback) {
+      call_method(name, params, std::move(callback));
+    }
+
+    void CallNotification(const std::string &name, const positional_parameter &params = {}) { call_notification(name, params); }
+    void CallNotificationNamed(const std::string &name, const named_parameter &params = {}) { call_notification(name, params); }
+
+    size_t Pending() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return pending.size();
+    }
+
+    // Fails all pending calls and every call made afterwards with error, without sending it. For
+    // connections that will not deliver responses any more.
+    void Close(const JsonRpcException &error) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = error;
+      }
+      FailPending(error);
+    }
+
+    // Completes all pending calls with error, e.g. when the connection was lost
+    void FailPending(const JsonRpcException &error) {
+      std::unordered_map<int64_t, CallCallback> failed;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed.swap(pending);
+      }
+      for (auto &call : failed) {
+        call.second(error);
+      }
+    }
+
+  protected:
+    IAsyncClientConnector &connector;
+
+  private:
+    std::atomic<int64_t> nextId;
+    mutable std::mutex mutex;
+    std::unordered_map<int64_t, CallCallback> pending;
+    std::optional<JsonRpcException> closed;
+
+    template <typename T>
+    std::future<T> call_future(const std::string &name, const json &params) {
+      auto promise = std::make_shared<std::promise<T>>();
+      std::future<T> future = promise->get_future();
+      call_method(name, params, [promise, name](CallResult result) {
+        if (auto *error = std::get_if<JsonRpcException>(&result)) {
+          promise->set_exception(std::make_exception_ptr(*error));
+          return;
+        }
+        try {
+          promise->set_value(std::get<json>(result).get<T>());
+        } catch (json::exception &e) {
+          promise->set_exception(std::make_exception_ptr(JsonRpcException(internal_error, name + ": invalid return type: " + e.what())));
+        }
+      });
+      return future;
+    }
+
+    void call_method(const std::string &name, const json &params, CallCallback callback) {
+      int64_t id = nextId++;
+      json j = {{"id", id}, {"jsonrpc", "2.0"}, {"method", name}};
+      if (!params.empty() || params.is_array()) {
+        j["params"] = params;
+      }
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closed) {
+          JsonRpcException error = *closed;
+          lock.unlock();
+          callback(error);
+          return;
+        }
+        pending.emplace(id, std::move(callback));
+      }
+      try {
+        connector.Send(j.dump());
+      } catch (std::exception &e) {
+        if (CallCallback failed = take(id)) {
+          failed(JsonRpcException(internal_error, name + ": sending request failed: " + e.what()));
+        }
+      }
+    }
+
+    void call_notification(const std::string &name, const json &params) {
+      json j = {{"jsonrpc", "2.0"}, {"method", name}};
+      if (!params.empty()) {
+        j["params"] = params;
+      }
+      connector.Send(j.dump());
+    }
+
+    CallCallback take(int64_t id) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto call = pending.find(id);
+      if (call == pending.end()) {
+        return nullptr;
+      }
+      CallCallback callback = std::move(call->second);
+      pending.erase(call);
+      return callback;
+    }
+
+    // Responses that cannot be matched to a pending call (unknown or null ids, invalid JSON) are dropped
+    void HandleMessage(const std::string &message) {
+      json response = json::parse(message, nullptr, false);
+      if (response.is_array()) {
+        for (auto &element : response) {
+          HandleResponse(element);
+        }
+      } else {
+        HandleResponse(response);
+      }
+    }
+
+    void HandleResponse(json &response) {
+      if (!response.is_object() || !has_key(response, "id") || !response["id"].is_number_integer()) {
+        return;
+      }
+      CallCallback callback = take(response["id"].get<int64_t>());
+      if (!callback) {
+        return;
+      }
+      if (has_key_type(response, "error", json::value_t::object)) {
+        callback(JsonRpcException::fromJson(response["error"]));
+      } else if (has_key(response, "result")) {
+        callback(std::move(response["result"]));
+      } else {
+        callback(JsonRpcException(internal_error, R"(invalid server response (neither "result" nor "error" fields found))"));
+      }
+    }
+  };
+} // namespace jsonrpccxx
@@ -1,6 +1,13 @@
 #pragma once
 
 #include "client.hpp"
+#include "serializer.hpp"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace jsonrpccxx {
   class BatchRequest {
@@ -44,51 +51,233 @@ namespace jsonrpccxx {
     json call;
   };
 
-  class BatchResponse {
+  // Builds a batch request directly in its serialized form: every call is appended to one buffer,
+  // typed arguments are serialized as they are added. BatchClient sends the buffer as is.
+  class BatchBuilder {
   public:
-    explicit BatchResponse(json &&response) : response(response), results(), errors(), nullIds() {
-      for (auto &[key, value] : response.items()) {
-        if (value.is_object() && valid_id_not_null(value) && has_key(value, "result")) {
-          results[value["id"]] = std::stoi(key);
-        } else if (value.is_object() && valid_id_not_null(value) && has_key(value, "error")) {
-          errors[value["id"]] = std::stoi(key);
-        } else {
-          nullIds.push_back(std::stoi(key));
+    explicit BatchBuilder(size_t expectedCalls = 0, size_t bytesPerCall = 64) : buffer(), calls(0) {
+      buffer.reserve(expectedCalls * bytesPerCall + 2);
+      buffer += "[]";
+    }
+
+    template <typename... Args>
+    BatchBuilder &AddMethodCall(const id_type &id, const std::string &name, const Args &...args) {
+      begin_call(&id, name);
+      append_json_list(buffer, args...);
+      return end_call();
+    }
+    BatchBuilder &AddMethodCall(const id_type &id, const std::string &name, const positional_parameter &params) {
+      begin_call(&id, name);
+      append_params(params);
+      return end_call();
+    }
+    BatchBuilder &AddNamedMethodCall(const id_type &id, const std::string &name, const named_parameter &params = {}) {
+      begin_call(&id, name, '{');
+      append_params(params);
+      return end_call('}');
+    }
+
+    template <typename... Args>
+    BatchBuilder &AddNotificationCall(const std::string &name, const Args &...args) {
+      begin_call(nullptr, name);
+      append_json_list(buffer, args...);
+      return end_call();
+    }
+    BatchBuilder &AddNotificationCall(const std::string &name, const positional_parameter &params) {
+      begin_call(nullptr, name);
+      append_params(params);
+      return end_call();
+    }
+    BatchBuilder &AddNamedNotificationCall(const std::string &name, const named_parameter &params = {}) {
+      begin_call(nullptr, name, '{');
+      append_params(params);
+      return end_call('}');
+    }
+
+    // The serialized batch, valid JSON after every call
+    const std::string &Buffer() const { return buffer; }
+    size_t Size() const { return calls; }
+
+  private:
+    std::string buffer;
+    size_t calls;
+
+    void begin_call(const id_type *id, const std::string &name, char params = '[') {
+      buffer.pop_back();
+      if (calls > 0) {
+        buffer += ',';
+      }
+      buffer += '{';
+      if (id != nullptr) {
+        buffer += "\"id\":";
+        std::visit([this](const auto &value) { append_json(buffer, value); }, *id);
+        buffer += ',';
+      }
+      buffer += "\"jsonrpc\":\"2.0\",\"method\":";
+      append_json_string(buffer, name);
+      buffer += ",\"params\":";
+      buffer += params;
+    }
+
+    BatchBuilder &end_call(char params = ']') {
+      buffer += params;
+      buffer += "}]";
+      calls++;
+      return *this;
+    }
+
+    void append_params(const positional_parameter &params) {
+      for (size_t i = 0; i < params.size(); i++) {
+        if (i > 0) {
+          buffer += ',';
         }
+        buffer += params[i].dump();
       }
     }
 
+    void append_params(const named_parameter &params) {
+      bool first = true;
+      for (const auto &[key, value] : params) {
+        if (!first) {
+          buffer += ',';
+        }
+        first = false;
+        append_json_string(buffer, key);
+        buffer += ':';
+        buffer += value.dump();
+      }
+    }
+  };
+
+  class BatchResponse {
+  public:
+    // The id index is built on first access
+    explicit BatchResponse(json &&response) : response(std::move(response)), indexed(false), errors(0), intIds(), stringIds(), numberIds(), nullIds() {}
+
     template <typename T>
     T Get(const json &id) {
-      if (results.find(id) != results.end()) {
-        try {
-          return response[results[id]]["result"].get<T>();
-        } catch (json::type_error &e) {
-          throw JsonRpcException(parse_error, "invalid return type: " + std::string(e.what()));
-        }
-      } else if (errors.find(id) != errors.end()) {
-        throw JsonRpcException::fromJson(response[errors[id]]["error"]);
+      const json *entry = find(id);
+      if (entry == nullptr) {
+        throw JsonRpcException(parse_error, std::string("no result found for id ") + id.dump());
+      }
+      auto result = entry->find("result");
+      if (result == entry->end()) {
+        throw JsonRpcException::fromJson((*entry)["error"]);
+      }
+      try {
+        return result->get<T>();
+      } catch (json::exception &e) {
+        throw JsonRpcException(parse_error, "invalid return type: " + std::string(e.what()));
       }
-      throw JsonRpcException(parse_error, std::string("no result found for id ") + id.dump());
     }
 
-    bool HasErrors() { return !errors.empty() || !nullIds.empty(); }
-    const std::vector<size_t> GetInvalidIndexes() { return nullIds; }
+    // Results for several ids in their order, throws like Get for the first id without a valid result
+    template <typename T>
+    std::vector<T> GetAll(const std::vector<json> &ids) {
+      std::vector<T> results;
+      results.reserve(ids.size());
+      for (const json &id : ids) {
+        results.push_back(Get<T>(id));
+      }
+      return results;
+    }
+
+    bool HasErrors() {
+      index();
+      return errors > 0 || !nullIds.empty();
+    }
+    const std::vector<size_t> GetInvalidIndexes() {
+      index();
+      return nullIds;
+    }
     const json& GetResponse() { return response; }
 
   private:
     json response;
-    std::map<json, size_t> results;
-    std::map<json, size_t> errors;
+    bool indexed;
+    size_t errors;
+    // Integer ids are the common case and hashed directly. Numbers are normalized so that ids which
+    // compare equal as JSON values share a key, e.g. 1 and 1.0.
+    std::unordered_map<int64_t, size_t> intIds;
+    std::unordered_map<std::string, size_t> stringIds;
+    std::unordered_map<double, size_t> numberIds;
     std::vector<size_t> nullIds;
+
+    // Integers and integral floats in the range of int64_t
+    static bool int_id(const json &id, int64_t &key) {
+      if (id.is_number_unsigned()) {
+        if (id.get<uint64_t>() > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+          return false;
+      } else if (id.is_number_float()) {
+        double value = id.get<double>();
+        // 2^63 itself does not fit
+        if (value != std::trunc(value) || value < -9223372036854775808.0 || value >= 9223372036854775808.0)
+          return false;
+      } else if (!id.is_number_integer()) {
+        return false;
+      }
+      key = id.get<int64_t>();
+      return true;
+    }
+
+    void index() {
+      if (indexed) {
+        return;
+      }
+      indexed = true;
+      intIds.reserve(response.size());
+      for (size_t i = 0; i < response.size(); i++) {
+        const json &value = response[i];
+        bool hasResult = value.is_object() && has_key(value, "result");
+        bool hasError = value.is_object() && has_key(value, "error");
+        if (!(hasResult || hasError) || !valid_id_not_null(value)) {
+          nullIds.push_back(i);
+          continue;
+        }
+        if (!hasResult) {
+          errors++;
+        }
+        const json &id = value["id"];
+        int64_t key;
+        if (int_id(id, key)) {
+          intIds[key] = i;
+        } else if (id.is_string()) {
+          stringIds[id.get_ref<const std::string &>()] = i;
+        } else {
+          numberIds[id.get<double>()] = i;
+        }
+      }
+    }
+
+    const json *find(const json &id) {
+      index();
+      int64_t key;
+      if (int_id(id, key)) {
+        auto entry = intIds.find(key);
+        return entry == intIds.end() ? nullptr : &response[entry->second];
+      }
+      if (id.is_string()) {
+        auto entry = stringIds.find(id.get_ref<const std::string &>());
+        return entry == stringIds.end() ? nullptr : &response[entry->second];
+      }
+      if (!id.is_number()) {
+        return nullptr;
+      }
+      auto entry = numberIds.find(id.get<double>());
+      return entry == numberIds.end() ? nullptr : &response[entry->second];
+    }
   };
 
   class BatchClient : public JsonRpcClient {
   public:
     explicit BatchClient(IClientConnector &connector) : JsonRpcClient(connector, version::v2) {}
-    BatchResponse BatchCall(const BatchRequest &request) {
+    BatchResponse BatchCall(const BatchRequest &request) { return batch_call(request.Build().dump()); }
+    BatchResponse BatchCall(const BatchBuilder &request) { return batch_call(request.Buffer()); }
+
+  private:
+    BatchResponse batch_call(const std::string &request) {
       try {
-        json response = json::parse(connector.Send(request.Build().dump()));
+        json response = json::parse(connector.Send(request));
         if (!response.is_array()) {
           throw JsonRpcException(parse_error, std::string("invalid JSON response from server: expected array"));
         }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jsonrpccxx {
+  // A serialized message as a sequence of byte ranges (scatter/gather, like iovec) together with the
+  // storage they point into. The server assembles responses from the envelope prefix, the result as
+  // the method serialized it and the suffix without concatenating them; transports write the
+  // segments as they are (e.g. with writev) or flatten them with ToString().
+  class ResponseBuffer {
+  public:
+    ResponseBuffer() : chunks(), segments(), size(0) {}
+    // Adapter for the string API, takes over text as the only segment
+    ResponseBuffer(std::string text) : ResponseBuffer() { Append(std::move(text)); }
+
+    // Chunks are kept in a list, so moving the buffer does not move the bytes the segments point to
+    ResponseBuffer(ResponseBuffer &&) noexcept = default;
+    ResponseBuffer &operator=(ResponseBuffer &&) noexcept = default;
+    ResponseBuffer(const ResponseBuffer &) = delete;
+    ResponseBuffer &operator=(const ResponseBuffer &) = delete;
+
+    // Appends a segment owning its bytes
+    void Append(std::string chunk) {
+      if (chunk.empty())
+        return;
+      chunks.push_back(std::move(chunk));
+      AppendView(chunks.back());
+    }
+
+    // Appends bytes that outlive the buffer, e.g. string literals
+    void AppendStatic(std::string_view bytes) {
+      if (!bytes.empty())
+        AppendView(bytes);
+    }
+
+    // Appends all segments of other, taking over its storage
+    void Append(ResponseBuffer &&other) {
+      chunks.splice(chunks.end(), other.chunks);
+      segments.insert(segments.end(), other.segments.begin(), other.segments.end());
+      size += other.size;
+      other.segments.clear();
+      other.size = 0;
+    }
+
+    const std::vector<std::string_view> &Segments() const { return segments; }
+    size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+
+    void AppendTo(std::string &out) const {
+      out.reserve(out.size() + size);
+      for (std::string_view segment : segments)
+        out.append(segment.data(), segment.size());
+    }
+
+    std::string ToString() const & {
+      std::string result;
+      AppendTo(result);
+      return result;
+    }
+
+    // A buffer consisting of one owned segment hands it over without copying
+    std::string ToString() && {
+      if (segments.size() == 1 && chunks.size() == 1)
+        return std::move(chunks.front());
+      std::string result;
+      AppendTo(result);
+      return result;
+    }
+
+  private:
+    std::list<std::string> chunks;
+    std::vector<std::string_view> segments;
+    size_t size;
+
+    void AppendView(std::string_view bytes) {
+      segments.push_back(bytes);
+      size += bytes.size();
+    }
+  };
+} // namespace jsonrpccxx
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace jsonrpccxx {
+  // Stores serialized results keyed by canonical (normalized and dumped) parameters.
+  // Entries are spread over independently locked shards and evicted in LRU order once a
+  // shard is full. Expired entries are dropped lazily on lookup.
+  //
+  // maxEntries is split evenly across the shards. Caches too small to give every shard
+  // minShardEntries use fewer shards, so that uneven hashing does not evict them early.
+  class ResultCache {
+  public:
+    typedef std::chrono::steady_clock clock;
+    static constexpr size_t minShardEntries = 64;
+
+    ResultCache(std::chrono::milliseconds ttl, size_t maxEntries, size_t shardCount = 16)
+        : ttl(ttl), shardCount(std::min(std::max<size_t>(shardCount, 1), std::max<size_t>(maxEntries / minShardEntries, 1))),
+          shardCapacity(std::max<size_t>((maxEntries + this->shardCount - 1) / this->shardCount, 1)), shards(new Shard[this->shardCount]), generation(0),
+          hits(0), misses(0) {}
+
+    bool Get(const std::string &key, std::string &result) {
+      Shard &shard = shard_for(key);
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto entry = shard.index.find(key);
+        if (entry != shard.index.end()) {
+          if (entry->second->expires > clock::now()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, entry->second);
+            result = entry->second->value;
+            hits++;
+            return true;
+          }
+          shard.lru.erase(entry->second);
+          shard.index.erase(entry);
+        }
+      }
+      misses++;
+      return false;
+    }
+
+    // Changes with every Clear(). Read it before computing a result and pass it to Put, so that a
+    // result computed before an invalidation is not stored after it.
+    uint64_t Generation() const { return generation; }
+
+    void Put(const std::string &key, std::string value) { Put(key, std::move(value), Generation()); }
+
+    // Drops value if the cache was cleared since generation was read; returns whether it was stored
+    bool Put(const std::string &key, std::string value, uint64_t generation) {
+      Shard &shard = shard_for(key);
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      // Clear() advances the generation before taking the shard locks, so a stale result either
+      // fails this check or is inserted before the shard is cleared
+      if (generation != this->generation) {
+        return false;
+      }
+      auto entry = shard.index.find(key);
+      if (entry != shard.index.end()) {
+        shard.lru.erase(entry->second);
+        shard.index.erase(entry);
+      }
+      while (shard.index.size() >= shardCapacity) {
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+      }
+      shard.lru.push_front(Entry{key, std::move(value), clock::now() + ttl});
+      shard.index[key] = shard.lru.begin();
+      return true;
+    }
+
+    void Clear() {
+      generation++;
+      for (size_t i = 0; i < shardCount; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].index.clear();
+        shards[i].lru.clear();
+      }
+    }
+
+    size_t Size() const {
+      size_t size = 0;
+      for (size_t i = 0; i < shardCount; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        size += shards[i].index.size();
+      }
+      return size;
+    }
+
+    size_t Hits() const { return hits; }
+    size_t Misses() const { return misses; }
+
+  private:
+    struct Entry {
+      std::string key;
+      std::string value;
+      clock::time_point expires;
+    };
+
+    struct Shard {
+      Shard() : mutex(), lru(), index() {}
+      mutable std::mutex mutex;
+      std::list<Entry> lru;
+      std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    std::chrono::milliseconds ttl;
+    size_t shardCount;
+    size_t shardCapacity;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<uint64_t> generation;
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+
+    Shard &shard_for(const std::string &key) { return shards[std::hash<std::string>()(key) % shardCount]; }
+  };
+} // namespace jsonrpccxx
@@ -1,9 +1,16 @@
 #pragma once
 #include "common.hpp"
+#include "envelope.hpp"
 #include "iclientconnector.hpp"
+#include "serializer.hpp"
+#include <chrono>
 #include <exception>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <variant>
 
 namespace jsonrpccxx {
@@ -12,6 +19,15 @@ namespace jsonrpccxx {
   typedef std::map<std::string, json> named_parameter;
   typedef std::variant<int, std::string> id_type;
 
+  // Arguments the positional_parameter overloads of JsonRpcClient::CallMethod take
+  template <typename... Args>
+  struct is_parameter_list : std::false_type {};
+  template <typename Params>
+  struct is_parameter_list<Params> : std::is_convertible<Params, positional_parameter> {};
+  template <typename Params, typename Timeout>
+  struct is_parameter_list<Params, Timeout>
+      : std::bool_constant<std::is_convertible<Params, positional_parameter>::value && std::is_convertible<Timeout, std::chrono::milliseconds>::value> {};
+
   struct JsonRpcResponse {
     id_type id;
     json result;
@@ -19,26 +35,85 @@ namespace jsonrpccxx {
 
   class JsonRpcClient {
   public:
-    JsonRpcClient(IClientConnector &connector, version v) : connector(connector), v(v) {}
+    JsonRpcClient(IClientConnector &connector, version v)
+        : connector(connector), direct(dynamic_cast<IDirectClientConnector *>(&connector)), v(v), prefixes(std::make_shared<Prefixes>()) {}
     virtual ~JsonRpcClient() = default;
+    JsonRpcClient(const JsonRpcClient &) = default;
+    JsonRpcClient &operator=(const JsonRpcClient &) = delete;
 
     template <typename T>
-    T CallMethod(const id_type &id, const std::string &name) { return call_method(id, name, json::object()).result.get<T>(); }
+    T CallMethod(const id_type &id, const std::string &name) { return call_method<T>(id, name, json::object()); }
      template <typename T>
-    T CallMethod(const id_type &id, const std::string &name, const positional_parameter &params) { return call_method(id, name, params).result.get<T>(); }
+    T CallMethod(const id_type &id, const std::string &name, const positional_parameter &params) { return call_method<T>(id, name, params); }
     template <typename T>
-    T CallMethodNamed(const id_type &id, const std::string &name, const named_parameter &params = {}) { return call_method(id, name, params).result.get<T>(); }
+    T CallMethodNamed(const id_type &id, const std::string &name, const named_parameter &params = {}) { return call_method<T>(id, name, params); }
+
+    // Serializes args straight into the request as positional parameters, e.g. CallMethod<int>(1, "add", 1, 2).
+    // Disabled where it would take over the positional_parameter overloads above.
+    template <typename T, typename... Args, typename = std::enable_if_t<(sizeof...(Args) > 0) && !is_parameter_list<Args...>::value>>
+    T CallMethod(const id_type &id, const std::string &name, Args &&...args) {
+      if (direct != nullptr) {
+        json params = json::array();
+        (params.push_back(json(std::forward<Args>(args))), ...);
+        return call_method<T>(id, name, params);
+      }
+      std::string request = prefix(name);
+      append_json_list(request, args...);
+      request += "],\"id\":";
+      std::visit([&request](const auto &value) { append_json(request, value); }, id);
+      request += '}';
+      return send_request<T>(name, request);
+    }
+
+    // Sends timeout along as "timeout_ms", the server drops the call if it did not start within it.
+    // 0 asks for no deadline, overriding the method's default one.
+    template <typename T>
+    T CallMethod(const id_type &id, const std::string &name, const positional_parameter &params, std::chrono::milliseconds timeout) {
+      return call_method<T>(id, name, params, timeout);
+    }
+    template <typename T>
+    T CallMethodNamed(const id_type &id, const std::string &name, const named_parameter &params, std::chrono::milliseconds timeout) {
+      return call_method<T>(id, name, params, timeout);
+    }
 
     void CallNotification(const std::string &name, const positional_parameter &params = {}) { call_notification(name, params); }
     void CallNotificationNamed(const std::string &name, const named_parameter &params = {}) { call_notification(name, params); }
 
+    // Asks a JsonRpc2Server to cancel the call with this id, if its method is cancellable
+    void CancelCall(const id_type &id) {
+      call_notification("rpc.cancel", named_parameter{{"id", std::visit([](const auto &value) { return json(value); }, id)}});
+    }
+
   protected:
     IClientConnector &connector;
 
   private:
+    static constexpr size_t max_retained_response = 1 << 20;
+    // The connector, if it takes requests as objects
+    IDirectClientConnector *direct;
     version v;
+    // Serialized request heads up to the opening bracket of the params, per method name
+    struct Prefixes {
+      Prefixes() : mutex(), byName() {}
+      std::mutex mutex;
+      std::unordered_map<std::string, std::string> byName;
+    };
+    std::shared_ptr<Prefixes> prefixes;
+
+    std::string prefix(const std::string &name) {
+      std::lock_guard<std::mutex> lock(prefixes->mutex);
+      auto cached = prefixes->byName.find(name);
+      if (cached != prefixes->byName.end()) {
+        return cached->second;
+      }
+      std::string head = v == version::v2 ? "{\"jsonrpc\":\"2.0\",\"method\":" : "{\"method\":";
+      append_json_string(head, name);
+      head += ",\"params\":[";
+      return prefixes->byName.emplace(name, std::move(head)).first->second;
+    }
 
-    JsonRpcResponse call_method(const id_type &id, const std::string &name, const json &params) {
+    template <typename T>
+    T call_method(const id_type &id, const std::string &name, const json &params, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1)) {
       json j = {{"method", name}};
       if (std::get_if<int>(&id) != nullptr) {
         j["id"] = std::get<int>(id);
@@ -55,25 +130,74 @@ namespace jsonrpccxx {
       } else if (v == version::v1) {
         j["params"] = nullptr;
       }
-      try {
-        json response = json::parse(connector.Send(j.dump()));
-        if (has_key_type(response, "error", json::value_t::object)) {
-          throw JsonRpcException::fromJson(response["error"]);
-        } else if (has_key_type(response, "error", json::value_t::string)) {
-          throw JsonRpcException(internal_error, response["error"]);
-        }
-        if (has_key(response, "result") && has_key(response, "id")) {
-          if (response["id"].type() == json::value_t::string)
-            return JsonRpcResponse{response["id"].get<std::string>(), response["result"].get<json>()};
-          else
-            return JsonRpcResponse{response["id"].get<int>(), response["result"].get<json>()};
+      if (timeout.count() >= 0) {
+        j["timeout_ms"] = timeout.count();
+      }
+      if (direct != nullptr) {
+        json response = direct->Call(std::move(j));
+        check_response(name, response);
+        return response["result"].template get<T>();
+      }
+      return send_request<T>(name, j.dump());
+    }
+
+    // Decodes the result straight from its span in the response, falls back to parse_response if the
+    // response is not a plain object. Responses are received into a per thread buffer, so steady
+    // traffic does not allocate for them; buffers grown by huge responses are released again.
+    template <typename T>
+    T send_request(const std::string &name, const std::string &request) {
+      static thread_local std::string raw;
+      if (raw.capacity() > max_retained_response) {
+        std::string().swap(raw);
+      }
+      connector.SendInto(request, raw);
+      ResponseEnvelope envelope;
+      if (scan_response(raw, envelope)) {
+        try {
+          if (!envelope.error.empty()) {
+            json error = json::parse(envelope.error);
+            if (error.is_object()) {
+              throw JsonRpcException::fromJson(error);
+            } else if (error.is_string()) {
+              throw JsonRpcException(internal_error, error);
+            }
+          }
+          if (!envelope.result.empty() && !envelope.id.empty()) {
+            return decode_json<T>(envelope.result);
+          }
+        } catch (json::parse_error &e) {
+          throw JsonRpcException(parse_error, name + ": invalid JSON response from server (" + e.what() + ")");
         }
         throw JsonRpcException(internal_error, name + R"(: invalid server response (neither "result" nor "error" fields found))");
+      }
+      return parse_response(name, raw).result.template get<T>();
+    }
+
+    JsonRpcResponse parse_response(const std::string &name, const std::string &raw) {
+      try {
+        json response = json::parse(raw);
+        check_response(name, response);
+        if (response["id"].type() == json::value_t::string)
+          return JsonRpcResponse{response["id"].get<std::string>(), response["result"].get<json>()};
+        else
+          return JsonRpcResponse{response["id"].get<int>(), response["result"].get<json>()};
       } catch (json::parse_error &e) {
         throw JsonRpcException(parse_error, name + ": invalid JSON response from server (" + e.what() + ")");
       }
     }
 
+    // Throws the error of the response, or if it has no result
+    static void check_response(const std::string &name, const json &response) {
+      if (has_key_type(response, "error", json::value_t::object)) {
+        throw JsonRpcException::fromJson(response["error"]);
+      } else if (has_key_type(response, "error", json::value_t::string)) {
+        throw JsonRpcException(internal_error, response["error"]);
+      }
+      if (!has_key(response, "result") || !has_key(response, "id")) {
+        throw JsonRpcException(internal_error, name + R"(: invalid server response (neither "result" nor "error" fields found))");
+      }
+    }
+
     void call_notification(const std::string &name, const nlohmann::json &params) {
       nlohmann::json j = {{"method", name}};
       if (v == version::v2) {
@@ -86,6 +210,10 @@ namespace jsonrpccxx {
       } else if (v == version::v1) {
         j["params"] = nullptr;
       }
+      if (direct != nullptr) {
+        direct->Call(std::move(j));
+        return;
+      }
       connector.Send(j.dump());
     }
   };
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "asyncclient.hpp"
+#include "batchclient.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace jsonrpccxx {
+  // Gathers individual calls into JSON-RPC batches. A batch is sent once its oldest call waited for
+  // window, or as soon as maxBatch calls are queued, whichever comes first. Ids are assigned
+  // automatically. Batches are sent one at a time from a background thread through a blocking
+  // IClientConnector; calls issued while a batch is in flight are gathered into the next one.
+  class CoalescingClient {
+  public:
+    CoalescingClient(IClientConnector &connector, std::chrono::microseconds window = std::chrono::milliseconds(1), size_t maxBatch = 64)
+        : connector(connector), window(window), maxBatch(std::max<size_t>(maxBatch, 1)), nextId(1), mutex(), cv(), queue(), stopping(false),
+          flushing(false), batches(0), calls(0), sender([this]() { run(); }) {}
+
+    // Sends everything still queued before returning
+    ~CoalescingClient() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      cv.notify_one();
+      sender.join();
+    }
+
+    CoalescingClient(const CoalescingClient &) = delete;
+    CoalescingClient &operator=(const CoalescingClient &) = delete;
+
+    template <typename T>
+    std::future<T> CallMethod(const std::string &name, const positional_parameter &params = {}) {
+      return call_future<T>(name, params);
+    }
+    template <typename T>
+    std::future<T> CallMethodNamed(const std::string &name, const named_parameter &params = {}) {
+      return call_future<T>(name, params);
+    }
+
+    // Notifications travel in the next batch, errors are not reported
+    void CallNotification(const std::string &name, const positional_parameter &params = {}) { enqueue(build(name, params, nullptr), nullptr); }
+    void CallNotificationNamed(const std::string &name, const named_parameter &params = {}) { enqueue(build(name, params, nullptr), nullptr); }
+
+    // Sends the queued calls without waiting for the window to close
+    void Flush() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushing = true;
+      }
+      cv.notify_one();
+    }
+
+    size_t Batches() const { return batches; }
+    size_t Calls() const { return calls; }
+
+  private:
+    struct Queued {
+      std::string request;
+      int64_t id;
+      CallCallback callback;
+      std::chrono::steady_clock::time_point queued;
+    };
+
+    IClientConnector &connector;
+    const std::chrono::microseconds window;
+    const size_t maxBatch;
+    std::atomic<int64_t> nextId;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Queued> queue;
+    bool stopping;
+    bool flushing;
+    std::atomic<size_t> batches;
+    std::atomic<size_t> calls;
+    std::thread sender;
+
+    template <typename T>
+    std::future<T> call_future(const std::string &name, const json &params) {
+      auto promise = std::make_shared<std::promise<T>>();
+      std::future<T> future = promise->get_future();
+      int64_t id = nextId++;
+      enqueue(build(name, params, id), [promise, name](CallResult result) {
+        if (auto *error = std::get_if<JsonRpcException>(&result)) {
+          promise->set_exception(std::make_exception_ptr(*error));
+          return;
+        }
+        try {
+          promise->set_value(std::get<json>(result).get<T>());
+        } catch (std::exception &e) {
+          // json::exception, or anything a user from_json throws
+          promise->set_exception(std::make_exception_ptr(JsonRpcException(internal_error, name + ": invalid return type: " + e.what())));
+        }
+      }, id);
+      return future;
+    }
+
+    static std::string build(const std::string &name, const json &params, const json &id) {
+      json j = {{"jsonrpc", "2.0"}, {"method", name}, {"params", params}};
+      if (!id.is_null()) {
+        j["id"] = id;
+      }
+      return j.dump();
+    }
+
+    void enqueue(std::string request, CallCallback callback, int64_t id = 0) {
+      bool full;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(Queued{std::move(request), id, std::move(callback), std::chrono::steady_clock::now()});
+        full = queue.size() == 1 || queue.size() >= maxBatch;
+      }
+      if (full) {
+        cv.notify_one();
+      }
+    }
+
+    void run() {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true) {
+        cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+          return;
+        }
+        cv.wait_until(lock, queue.front().queued + window, [this]() { return stopping || flushing || queue.size() >= maxBatch; });
+        size_t count = std::min(queue.size(), maxBatch);
+        std::vector<Queued> batch(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + static_cast<std::ptrdiff_t>(count)));
+        queue.erase(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(count));
+        flushing = flushing && !queue.empty();
+        lock.unlock();
+        send(batch);
+        lock.lock();
+      }
+    }
+
+    void send(std::vector<Queued> &batch) {
+      std::string request = "[";
+      for (const Queued &call : batch) {
+        if (request.size() > 1) {
+          request += ',';
+        }
+        request += call.request;
+      }
+      request += ']';
+      batches++;
+      calls += batch.size();
+      try {
+        std::string raw = connector.Send(request);
+        if (raw.empty()) {
+          fail(batch, JsonRpcException(internal_error, "invalid server response: empty response to a batch containing method calls"));
+          return;
+        }
+        json response = json::parse(raw);
+        if (!response.is_array()) {
+          fail(batch, has_key_type(response, "error", json::value_t::object) ? JsonRpcException::fromJson(response["error"])
+                                                                              : JsonRpcException(parse_error, "invalid JSON response from server: expected array"));
+          return;
+        }
+        BatchResponse results(std::move(response));
+        for (Queued &call : batch) {
+          CallResult result = JsonRpcException(internal_error, "");
+          try {
+            result = results.Get<json>(call.id);
+          } catch (JsonRpcException &e) {
+            result = e;
+          }
+          resolve(call, std::move(result));
+        }
+      } catch (json::parse_error &e) {
+        fail(batch, JsonRpcException(parse_error, std::string("invalid JSON response from server: ") + e.what()));
+      } catch (std::exception &e) {
+        fail(batch, JsonRpcException(internal_error, std::string("sending batch failed: ") + e.what()));
+      }
+    }
+
+    // Calls that were resolved already are skipped
+    static void fail(std::vector<Queued> &batch, const JsonRpcException &error) {
+      for (Queued &call : batch) {
+        resolve(call, error);
+      }
+    }
+
+    // Hands result to the call's callback at most once; a callback that throws is not called again
+    static void resolve(Queued &call, CallResult result) {
+      CallCallback callback = std::move(call.callback);
+      call.callback = nullptr;
+      if (!callback) {
+        return;
+      }
+      try {
+        callback(std::move(result));
+      } catch (std::exception &) {
+        // The callback failed on its own result, reporting an error to it as well would complete it twice
+      }
+    }
+  };
+} // namespace jsonrpccxx
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "common.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Declares the JSON form of a struct as a compile-time field table, generating to_json/from_json
+// that read and write the members directly. Place it in the namespace of the type:
+//
+//   JSONRPCCXX_STRUCT(Product, JSONRPCCXX_FIELD(id), JSONRPCCXX_FIELD(price), JSONRPCCXX_FIELD_AS(cat, "category"))
+//
+// Missing fields raise json::type_error, unknown ones are ignored.
+#define JSONRPCCXX_FIELD(member) ::jsonrpccxx::make_field(#member, &jsonrpccxx_type::member)
+#define JSONRPCCXX_FIELD_AS(member, name) ::jsonrpccxx::make_field(name, &jsonrpccxx_type::member)
+
+#define JSONRPCCXX_STRUCT(Type, ...)                                                                                                                           \
+  constexpr auto jsonrpccxx_fields(const Type *) {                                                                                                             \
+    typedef Type jsonrpccxx_type;                                                                                                                              \
+    return std::make_tuple(__VA_ARGS__);                                                                                                                       \
+  }                                                                                                                                                            \
+  inline void to_json(nlohmann::json &j, const Type &value) { ::jsonrpccxx::write_fields(j, value); }                                                         \
+  inline void from_json(const nlohmann::json &j, Type &value) { ::jsonrpccxx::read_fields(j, value); }
+
+// Same for enums, mapping each value to a string:
+//
+//   JSONRPCCXX_ENUM(category, {category::order, "order"}, {category::cash_carry, "cc"})
+//
+// Unlisted values and unknown strings raise json::type_error.
+#define JSONRPCCXX_ENUM(Type, ...)                                                                                                                             \
+  constexpr auto jsonrpccxx_enum_names(const Type *) { return ::jsonrpccxx::make_enum_names<Type>({__VA_ARGS__}); }                                           \
+  inline void to_json(nlohmann::json &j, const Type &value) { j = ::jsonrpccxx::enum_to_name(value); }                                                        \
+  inline void from_json(const nlohmann::json &j, Type &value) { value = ::jsonrpccxx::enum_from_json<Type>(j); }
+
+namespace jsonrpccxx {
+  // FNV-1a, used to match member names against field tables
+  constexpr uint64_t field_hash(std::string_view name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : name) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  template <typename Class, typename Member>
+  struct Field {
+    typedef Member type;
+    std::string_view name;
+    uint64_t hash;
+    Member Class::*member;
+  };
+
+  template <typename Class, typename Member>
+  constexpr Field<Class, Member> make_field(std::string_view name, Member Class::*member) {
+    return Field<Class, Member>{name, field_hash(name), member};
+  }
+
+  template <typename E>
+  struct EnumName {
+    E value;
+    const char *name;
+  };
+
+  template <typename E>
+  struct EnumEntry {
+    E value;
+    std::string_view name;
+    uint64_t hash;
+  };
+
+  template <typename E, size_t N>
+  struct EnumNames {
+    std::array<EnumEntry<E>, N> entries;
+    // Entry indexes ordered by name hash, names are binary searched
+    std::array<size_t, N> byHash;
+    // Set if entry i holds the value i, values are then looked up by index
+    bool dense;
+  };
+
+  template <typename E, size_t N>
+  constexpr EnumNames<E, N> make_enum_names(const EnumName<E> (&names)[N]) {
+    EnumNames<E, N> result{{}, {}, true};
+    for (size_t i = 0; i < N; i++) {
+      result.entries[i] = EnumEntry<E>{names[i].value, names[i].name, field_hash(names[i].name)};
+      result.dense = result.dense && static_cast<size_t>(names[i].value) == i;
+      // Insertion sort, std::sort is not constexpr before C++20
+      size_t j = i;
+      for (; j > 0 && result.entries[result.byHash[j - 1]].hash > result.entries[i].hash; j--) {
+        result.byHash[j] = result.byHash[j - 1];
+      }
+      result.byHash[j] = i;
+    }
+    return result;
+  }
+
+  template <typename T, typename = void>
+  struct has_fields : std::false_type {};
+  template <typename T>
+  struct has_fields<T, std::void_t<decltype(jsonrpccxx_fields(static_cast<const T *>(nullptr)))>> : std::true_type {};
+
+  template <typename T, typename = void>
+  struct has_enum_names : std::false_type {};
+  template <typename T>
+  struct has_enum_names<T, std::void_t<decltype(jsonrpccxx_enum_names(static_cast<const T *>(nullptr)))>> : std::true_type {};
+
+  template <typename T>
+  constexpr auto fields_of() {
+    return jsonrpccxx_fields(static_cast<const T *>(nullptr));
+  }
+
+  template <typename E>
+  constexpr auto enum_names_of() {
+    return jsonrpccxx_enum_names(static_cast<const E *>(nullptr));
+  }
+
+  template <typename T>
+  constexpr size_t field_count() {
+    return std::tuple_size<decltype(fields_of<T>())>::value;
+  }
+
+  // Calls f(field, index) for the field named key, returns false if there is none
+  template <typename T, typename F>
+  bool visit_field(std::string_view key, F &&f) {
+    static constexpr auto fields = fields_of<T>();
+    uint64_t hash = field_hash(key);
+    return std::apply(
+        [&](const auto &...field) {
+          size_t index = 0;
+          return ((field.hash == hash && field.name == key ? (f(field, index), true) : (index++, false)) || ...);
+        },
+        fields);
+  }
+
+  template <typename T>
+  constexpr uint64_t all_fields() {
+    static_assert(field_count<T>() <= 64, "JSONRPCCXX_STRUCT supports up to 64 fields");
+    return field_count<T>() == 64 ? ~0ull : (1ull << field_count<T>()) - 1;
+  }
+
+  // Throws json::type_error naming the first field whose bit is not set in seen
+  template <typename T>
+  [[noreturn]] void throw_missing_field(uint64_t seen) {
+    static constexpr auto fields = fields_of<T>();
+    std::string_view missing;
+    std::apply(
+        [&](const auto &...field) {
+          size_t index = 0;
+          ((missing.empty() && (seen & (1ull << index)) == 0 ? (void)(missing = field.name) : (void)0, index++), ...);
+        },
+        fields);
+    throw json::type_error::create(302, "missing field \"" + std::string(missing) + "\"");
+  }
+
+  template <typename T>
+  void write_fields(json &j, const T &value) {
+    static constexpr auto fields = fields_of<T>();
+    j = json::object();
+    auto &object = j.get_ref<json::object_t &>();
+    std::apply([&](const auto &...field) { (object.emplace(std::string(field.name), value.*(field.member)), ...); }, fields);
+  }
+
+  template <typename T>
+  void read_fields(const json &j, T &value) {
+    if (!j.is_object()) {
+      throw json::type_error::create(302, "type must be object, but is " + std::string(j.type_name()));
+    }
+    uint64_t seen = 0;
+    for (auto it = j.begin(); it != j.end(); ++it) {
+      visit_field<T>(it.key(), [&](const auto &field, size_t index) {
+        it.value().get_to(value.*(field.member));
+        seen |= 1ull << index;
+      });
+    }
+    if (seen != all_fields<T>()) {
+      throw_missing_field<T>(seen);
+    }
+  }
+
+  template <typename E>
+  std::string_view enum_to_name(E value) {
+    static constexpr auto names = enum_names_of<E>();
+    if (names.dense) {
+      auto index = static_cast<size_t>(value);
+      if (index < names.entries.size()) {
+        return names.entries[index].name;
+      }
+    } else {
+      for (const auto &entry : names.entries) {
+        if (entry.value == value) {
+          return entry.name;
+        }
+      }
+    }
+    throw json::type_error::create(302, "enum value " + std::to_string(static_cast<long long>(value)) + " has no name");
+  }
+
+  // Returns false if name is not listed
+  template <typename E>
+  bool enum_from_name(std::string_view name, E &value) {
+    static constexpr auto names = enum_names_of<E>();
+    uint64_t wanted = field_hash(name);
+    size_t low = 0, high = names.byHash.size();
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (wanted > names.entries[names.byHash[middle]].hash) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    for (; low < names.byHash.size() && names.entries[names.byHash[low]].hash == wanted; low++) {
+      const auto &entry = names.entries[names.byHash[low]];
+      if (entry.name == name) {
+        value = entry.value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename E>
+  E enum_from_json(const json &j) {
+    if (!j.is_string()) {
+      throw json::type_error::create(302, "type must be string, but is " + std::string(j.type_name()));
+    }
+    E value{};
+    if (!enum_from_name(j.get_ref<const std::string &>(), value)) {
+      throw json::type_error::create(302, "invalid enum value \"" + j.get<std::string>() + "\"");
+    }
+    return value;
+  }
+} // namespace jsonrpccxx
@@ -1,5 +1,8 @@
 #pragma once
 #include "nlohmann/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <exception>
 #include <string>
 
@@ -13,6 +16,23 @@ namespace jsonrpccxx {
   }
   static inline bool valid_id_not_null(const json &request) { return has_key(request, "id") && (request["id"].is_number() || request["id"].is_string()); }
 
+  // Longest "timeout_ms" a request or method metadata can ask for, longer ones are cut to it
+  static constexpr uint64_t max_timeout_ms = 24 * 60 * 60 * 1000;
+
+  // Reads a "timeout_ms" value, which has to be a non-negative integer. Returns false for anything else.
+  static inline bool parse_timeout(const json &value, std::chrono::milliseconds &timeout) {
+    uint64_t ms;
+    if (value.is_number_unsigned()) {
+      ms = value.get<uint64_t>();
+    } else if (value.is_number_integer() && value.get<int64_t>() >= 0) {
+      ms = static_cast<uint64_t>(value.get<int64_t>());
+    } else {
+      return false;
+    }
+    timeout = std::chrono::milliseconds(static_cast<int64_t>(std::min(ms, max_timeout_ms)));
+    return true;
+  }
+
   enum error_type {
     parse_error = -32700,
     invalid_request = -32600,
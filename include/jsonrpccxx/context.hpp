@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace jsonrpccxx {
+  // Set once a call was cancelled, handlers either poll Cancelled() or block in WaitFor()
+  class CancellationToken {
+  public:
+    CancellationToken() : mutex(), cv(), cancelled(false) {}
+
+    void Cancel() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+      }
+      cv.notify_all();
+    }
+
+    bool Cancelled() const { return cancelled; }
+
+    // Returns true as soon as the token is cancelled, false if timeout elapsed first
+    template <typename Rep, typename Period>
+    bool WaitFor(const std::chrono::duration<Rep, Period> &timeout) const {
+      std::unique_lock<std::mutex> lock(mutex);
+      return cv.wait_for(lock, timeout, [this]() { return cancelled.load(); });
+    }
+
+  private:
+    mutable std::mutex mutex;
+    mutable std::condition_variable cv;
+    std::atomic<bool> cancelled;
+  };
+
+  // Information about the call a handler is currently running for, available to handlers through
+  // RequestContext::Current() while JsonRpc2Server invokes them.
+  class RequestContext {
+  public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit RequestContext(clock::time_point deadline = clock::time_point::max(), const CancellationToken *token = nullptr)
+        : deadline(deadline), token(token) {}
+
+    bool HasDeadline() const { return deadline != clock::time_point::max(); }
+    clock::time_point Deadline() const { return deadline; }
+    bool Expired() const { return HasDeadline() && clock::now() >= deadline; }
+
+    // Time left until the deadline, zero once it passed and max() without a deadline
+    clock::duration Remaining() const {
+      if (!HasDeadline())
+        return clock::duration::max();
+      auto now = clock::now();
+      return now >= deadline ? clock::duration::zero() : deadline - now;
+    }
+
+    // Only calls of methods with {"cancellable": true} metadata have a token, nullptr otherwise
+    const CancellationToken *Token() const { return token; }
+    bool Cancelled() const { return token != nullptr && token->Cancelled(); }
+
+    // Returns nullptr outside of handlers
+    static const RequestContext *Current() { return current; }
+
+    // Makes a context current for the lifetime of the scope
+    class Scope {
+    public:
+      explicit Scope(const RequestContext &context) : previous(current) { current = &context; }
+      ~Scope() { current = previous; }
+      Scope(const Scope &) = delete;
+      Scope &operator=(const Scope &) = delete;
+
+    private:
+      const RequestContext *previous;
+    };
+
+  private:
+    clock::time_point deadline;
+    const CancellationToken *token;
+
+    inline static thread_local const RequestContext *current = nullptr;
+  };
+} // namespace jsonrpccxx
@@ -1,17 +1,44 @@
 #pragma once
 
+#include "admission.hpp"
+#include "cache.hpp"
 #include "common.hpp"
+#include "executor.hpp"
+#include "singleflight.hpp"
 #include "typemapper.hpp"
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <map>
+#include <memory>
 #include <string>
 #include <sstream>
 #include <vector>
 
 namespace jsonrpccxx {
 
+  // Runtime behaviour of a method, derived from its metadata:
+  //   "cacheable" (bool), "ttl_ms" (integer > 0, default 1000), "max_entries" (integer > 0, default 1024): serve results from a ResultCache
+  //   "coalescible" (bool): identical concurrent calls share one execution
+  //   "executor" (string): name of the server executor the handler runs on
+  //   "strand" (string): handlers sharing a strand name never run concurrently
+  //   "max_in_flight" (integer >= 0): calls beyond this many running or queued ones are rejected by JsonRpc2Server, 0 for no bound
+  //   "timeout_ms" (integer >= 0): default deadline of calls that do not carry their own "timeout_ms" member, 0 for none
+  //   "cancellable" (bool): calls can be cancelled by id through the rpc.cancel notification
+  struct MethodPolicy {
+    MethodPolicy() : cache(), flight(), executor(), strand(), limit(), timeout(0), cancellable(false) {}
+    std::shared_ptr<ResultCache> cache;
+    std::shared_ptr<SingleFlight> flight;
+    std::string executor;
+    std::shared_ptr<Strand> strand;
+    std::shared_ptr<InFlightLimit> limit;
+    std::chrono::milliseconds timeout;
+    bool cancellable;
+  };
+
   class Dispatcher {
   public:
     Dispatcher() :
@@ -21,7 +48,10 @@ namespace jsonrpccxx {
       metadatas(),
       mapping(),
       paramTypes(),
-      paramDocstrings()
+      paramDocstrings(),
+      policies(),
+      bulks(),
+      strands()
     {}
 
     bool Add(const std::string &name, const std::string &docstring, MethodHandle callback, const NamedParamMapping &mapping = NAMED_PARAM_MAPPING) {
@@ -240,6 +270,70 @@ namespace jsonrpccxx {
       return this->Add(name, docstring, cb, cls, NamedParamMapping(args));
     }
 
+    // Registers a method whose handler receives the calls of a whole batch at once. Single calls
+    // outside of a batch are passed to the handler as a batch of one.
+    bool AddBulk(const std::string &name, const std::string &docstring, BulkHandle callback, const NamedParamMapping &mapping = NAMED_PARAM_MAPPING) {
+      if (Contains(name))
+        return false;
+      methods[name] = [callback, name](const json &params) -> json {
+        std::vector<BulkResult<json>> results = callback({params});
+        if (results.size() != 1) {
+          throw std::runtime_error("bulk handler returned " + std::to_string(results.size()) + " results for 1 call");
+        }
+        if (auto *error = std::get_if<JsonRpcException>(&results[0])) {
+          throw *error;
+        }
+        return std::get<json>(std::move(results[0]));
+      };
+      bulks[name] = std::move(callback);
+      docstrings[name] = docstring;
+      if (!mapping.empty()) {
+        this->mapping[name] = mapping;
+      }
+      return true;
+    }
+
+    template <typename Result, typename... ParamTypes>
+    bool AddBulk(
+      const std::string &name,
+      const std::string &docstring,
+      std::function<std::vector<Result>(const std::vector<std::tuple<ParamTypes...>> &)> method,
+      const NamedParamMapping &args = NAMED_PARAM_MAPPING,
+      const NamedParamMapping &argDocstrings = NAMED_PARAM_MAPPING)
+    {
+      if (Contains(name))
+        return false;
+
+      if((sizeof...(ParamTypes) != argDocstrings.size()) and not argDocstrings.empty()) {
+        std::ostringstream errMsgStream;
+        errMsgStream << "Error registering RPC method \"" << name << "\": number of listed parameters ("
+                     << sizeof...(ParamTypes) << ") must match number of parameter docstrings ("
+                     << argDocstrings.size() << "), or no docstrings must be provided.";
+
+        throw std::invalid_argument(errMsgStream.str());
+      }
+
+      NamedParamMapping types;
+      BulkHandle handle = createBulkHandle(name, args, std::move(method), std::index_sequence_for<ParamTypes...>{}, types);
+      AddBulk(name, docstring, std::move(handle), args);
+      if (!args.empty()) {
+        paramTypes[name] = std::move(types);
+        paramDocstrings[name] = argDocstrings;
+      }
+      return true;
+    }
+
+    template <typename Func>
+    inline bool AddBulk(
+      const std::string &name,
+      const std::string &docstring,
+      Func method,
+      const NamedParamMapping &args = NAMED_PARAM_MAPPING,
+      const NamedParamMapping &argDocstrings = NAMED_PARAM_MAPPING)
+    {
+      return this->AddBulk(name, docstring, std::function(method), args, argDocstrings);
+    }
+
     template <typename... ArgsType>
     void ForceAdd(
         const std::string &name,
@@ -258,6 +352,10 @@ namespace jsonrpccxx {
 
     inline bool Contains(const std::string &name) const { return (ContainsMethod(name) || ContainsNotification(name)); }
 
+    inline bool ContainsBulk(const std::string &name) const { return (bulks.find(name) != bulks.end()); }
+
+    inline bool HasBulkMethods() const { return !bulks.empty(); }
+
     bool Remove(const std::string &name) {
       if (!Contains(name))
         return false;
@@ -267,17 +365,76 @@ namespace jsonrpccxx {
       metadatas.erase(name);
       paramTypes.erase(name);
       paramDocstrings.erase(name);
+      policies.erase(name);
+      bulks.erase(name);
       return true;
     }
 
     // Ideally, this would be part of the Add call, but I couldn't get overloading to work.
+    // Returns false for unknown methods and for metadata whose entries have the wrong type
     bool AddMethodMetadata(const std::string &name, const nlohmann::json &metadata) {
-      if (!Contains(name))
+      if (!Contains(name) || !valid_metadata(metadata))
         return false;
       metadatas[name] = metadata;
+      policies[name] = make_policy(name, metadata);
       return true;
     }
 
+    // Returns nullptr for methods without metadata
+    const MethodPolicy *Policy(const std::string &name) const {
+      auto policy = policies.find(name);
+      return policy == policies.end() ? nullptr : &policy->second;
+    }
+
+    bool InvalidateCache(const std::string &name) {
+      auto policy = policies.find(name);
+      if (policy == policies.end() || !policy->second.cache)
+        return false;
+      policy->second.cache->Clear();
+      return true;
+    }
+
+    nlohmann::json CacheStatistics() const {
+      nlohmann::json stats = nlohmann::json::object();
+      for (const auto &[name, policy] : policies) {
+        if (policy.cache) {
+          stats[name] = {{"hits", policy.cache->Hits()}, {"misses", policy.cache->Misses()}, {"entries", policy.cache->Size()}};
+        }
+      }
+      return stats;
+    }
+
+    nlohmann::json StrandStatistics() const {
+      nlohmann::json stats = nlohmann::json::object();
+      for (const auto &[name, strand] : strands) {
+        stats[name] = {{"executed", strand->Executed()},
+                       {"contended", strand->Contended()},
+                       {"max_queue", strand->MaxQueue()},
+                       {"wait_us", strand->WaitTime().count()}};
+      }
+      return stats;
+    }
+
+    nlohmann::json AdmissionStatistics() const {
+      nlohmann::json stats = nlohmann::json::object();
+      for (const auto &[name, policy] : policies) {
+        if (policy.limit) {
+          stats[name] = {{"in_flight", policy.limit->InFlight()}, {"max_in_flight", policy.limit->Limit()}, {"rejected", policy.limit->Rejected()}};
+        }
+      }
+      return stats;
+    }
+
+    nlohmann::json CoalescingStatistics() const {
+      nlohmann::json stats = nlohmann::json::object();
+      for (const auto &[name, policy] : policies) {
+        if (policy.flight) {
+          stats[name] = policy.flight->Shared();
+        }
+      }
+      return stats;
+    }
+
     std::vector<std::string> MethodNames() const {
       std::vector<std::string> names;
       for(const auto &mapPair: methods) {
@@ -364,20 +521,105 @@ namespace jsonrpccxx {
     }
 
     json InvokeMethod(const std::string &name, const json &params) {
-      auto method = methods.find(name);
-      if (method == methods.end()) {
+      const MethodHandle &method = find_method(name);
+      return invoke_method(name, method, normalize_parameter(name, params));
+    }
+
+    // Same as InvokeMethod, but returns the serialized result. Cacheable methods are answered from
+    // their cache without calling the handler or serializing the result again. Calls to coalescible
+    // methods wait for an identical call that is already running, or that was answered earlier in
+    // the same batch (memo), instead of executing again.
+    std::string InvokeMethodSerialized(const std::string &name, const json &params, CallMemo *memo = nullptr) {
+      const MethodHandle &method = find_method(name);
+      json normalized = normalize_parameter(name, params);
+      auto policy = policies.find(name);
+      if (policy == policies.end() || (!policy->second.cache && !policy->second.flight)) {
+        return invoke_method(name, method, normalized).dump();
+      }
+      const MethodPolicy &p = policy->second;
+      std::string key = normalized.dump();
+      std::string result;
+      if (p.cache && p.cache->Get(key, result)) {
+        return result;
+      }
+      auto execute = [&]() {
+        uint64_t generation = p.cache ? p.cache->Generation() : 0;
+        std::string r = invoke_method(name, method, normalized).dump();
+        if (p.cache) {
+          p.cache->Put(key, r, generation);
+        }
+        return r;
+      };
+      if (!p.flight) {
+        return execute();
+      }
+      std::string memoKey = name + '\0' + key;
+      if (memo && memo->Get(memoKey, result)) {
+        p.flight->RecordShared();
+        return result;
+      }
+      result = p.flight->Do(key, execute);
+      if (memo) {
+        memo->Put(memoKey, result);
+      }
+      return result;
+    }
+
+    // Same as InvokeMethodSerialized, for in-process callers that want the result as DOM. Results of
+    // cacheable and coalescible methods are shared in serialized form, only these are parsed back.
+    // Other results are not serialized, but fail like InvokeMethodSerialized if they could not be.
+    json InvokeMethodDirect(const std::string &name, const json &params, CallMemo *memo = nullptr) {
+      auto policy = policies.find(name);
+      if (policy != policies.end() && (policy->second.cache || policy->second.flight)) {
+        return json::parse(InvokeMethodSerialized(name, params, memo));
+      }
+      json result = InvokeMethod(name, params);
+      if (!serializable(result)) {
+        // Throws the same json::type_error as serializing on the wire path
+        (void)result.dump();
+      }
+      return result;
+    }
+
+    // Invokes a bulk method once for all given calls, returning one result or error per call.
+    std::vector<BulkResult<json>> InvokeBulk(const std::string &name, const std::vector<json> &params) {
+      auto bulk = bulks.find(name);
+      if (bulk == bulks.end()) {
         throw JsonRpcException(method_not_found, "method not found: " + name);
       }
+      std::vector<BulkResult<json>> results(params.size());
+      std::vector<json> normalized;
+      std::vector<size_t> positions;
+      normalized.reserve(params.size());
+      positions.reserve(params.size());
+      for (size_t i = 0; i < params.size(); i++) {
+        try {
+          normalized.push_back(normalize_parameter(name, params[i]));
+          positions.push_back(i);
+        } catch (JsonRpcException &e) {
+          results[i] = e;
+        }
+      }
+      if (normalized.empty()) {
+        return results;
+      }
+      std::vector<BulkResult<json>> values;
       try {
-        return method->second(normalize_parameter(name, params));
-      } catch (json::type_error &e) {
-        throw JsonRpcException(invalid_params, name + ": invalid parameter (" + e.what() + ")");
-      } catch (JsonRpcException &e) {
-        throw process_type_error(name, e);
-      } catch (std::exception &e) {
-        // Exception type doesn't matter here
-        throw std::runtime_error(name + ": " + e.what());
+        values = bulk->second(normalized);
+        if (values.size() != normalized.size()) {
+          throw std::runtime_error("bulk handler returned " + std::to_string(values.size()) + " results for " + std::to_string(normalized.size()) + " calls");
+        }
+      } catch (...) {
+        JsonRpcException error = current_bulk_error(name);
+        for (size_t position : positions) {
+          results[position] = error;
+        }
+        return results;
+      }
+      for (size_t i = 0; i < values.size(); i++) {
+        results[positions[i]] = std::move(values[i]);
       }
+      return results;
     }
 
     void InvokeNotification(const std::string &name, const json &params) {
@@ -402,6 +644,129 @@ namespace jsonrpccxx {
     std::map<std::string, NamedParamMapping> mapping;
     std::map<std::string, NamedParamMapping> paramTypes;
     std::map<std::string, NamedParamMapping> paramDocstrings;
+    std::map<std::string, MethodPolicy> policies;
+    std::map<std::string, BulkHandle> bulks;
+    std::map<std::string, std::shared_ptr<Strand>> strands;
+
+    // Whether dump() succeeds, i.e. all strings and keys are valid UTF-8, without building the text
+    static bool serializable(const json &value) {
+      switch (value.type()) {
+      case json::value_t::string:
+        return valid_utf8(value.get_ref<const std::string &>());
+      case json::value_t::array:
+        return std::all_of(value.begin(), value.end(), [](const json &element) { return serializable(element); });
+      case json::value_t::object:
+        for (auto &member : value.items()) {
+          if (!valid_utf8(member.key()) || !serializable(member.value()))
+            return false;
+        }
+        return true;
+      default:
+        return true;
+      }
+    }
+
+    // Well-formed UTF-8: no overlong forms, surrogates or code points beyond U+10FFFF
+    static bool valid_utf8(const std::string &text) {
+      size_t i = 0;
+      while (i < text.size()) {
+        auto byte = [&text](size_t at) { return static_cast<unsigned char>(text[at]); };
+        unsigned char lead = byte(i);
+        size_t length;
+        unsigned char low = 0x80, high = 0xBF;
+        if (lead < 0x80) {
+          i++;
+          continue;
+        } else if (lead >= 0xC2 && lead <= 0xDF) {
+          length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+          length = 3;
+          low = lead == 0xE0 ? 0xA0 : 0x80;
+          high = lead == 0xED ? 0x9F : 0xBF;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+          length = 4;
+          low = lead == 0xF0 ? 0x90 : 0x80;
+          high = lead == 0xF4 ? 0x8F : 0xBF;
+        } else {
+          return false;
+        }
+        if (text.size() - i < length || byte(i + 1) < low || byte(i + 1) > high)
+          return false;
+        for (size_t k = 2; k < length; k++) {
+          if (byte(i + k) < 0x80 || byte(i + k) > 0xBF)
+            return false;
+        }
+        i += length;
+      }
+      return true;
+    }
+
+    // Checks every entry make_policy reads, so that it never throws or wraps a negative size
+    static bool valid_metadata(const nlohmann::json &metadata) {
+      if (!metadata.is_object())
+        return true;
+      auto is = [&metadata](const char *key, nlohmann::json::value_t type) { return !metadata.contains(key) || has_key_type(metadata, key, type); };
+      auto at_least = [&metadata](const char *key, int64_t minimum) {
+        return !metadata.contains(key) || (metadata[key].is_number_integer() && metadata[key].get<int64_t>() >= minimum);
+      };
+      std::chrono::milliseconds timeout(0);
+      if (metadata.contains("timeout_ms") && !parse_timeout(metadata["timeout_ms"], timeout))
+        return false;
+      using value_t = nlohmann::json::value_t;
+      return is("cacheable", value_t::boolean) && is("coalescible", value_t::boolean) && is("cancellable", value_t::boolean) && is("executor", value_t::string) &&
+             is("strand", value_t::string) && at_least("ttl_ms", 1) && at_least("max_entries", 1) && at_least("max_in_flight", 0);
+    }
+
+    MethodPolicy make_policy(const std::string &name, const nlohmann::json &metadata) {
+      MethodPolicy policy;
+      if (!metadata.is_object())
+        return policy;
+      if (ContainsMethod(name) && metadata.value("cacheable", false)) {
+        policy.cache = std::make_shared<ResultCache>(std::chrono::milliseconds(metadata.value("ttl_ms", 1000)),
+                                                     metadata.value("max_entries", size_t(1024)));
+      }
+      if (ContainsMethod(name) && metadata.value("coalescible", false)) {
+        policy.flight = std::make_shared<SingleFlight>();
+      }
+      policy.executor = metadata.value("executor", "");
+      std::string strand = metadata.value("strand", "");
+      if (!strand.empty()) {
+        auto &shared = strands[strand];
+        if (!shared) {
+          shared = std::make_shared<Strand>();
+        }
+        policy.strand = shared;
+      }
+      if (metadata.contains("max_in_flight") && metadata["max_in_flight"] > 0) {
+        policy.limit = std::make_shared<InFlightLimit>(metadata["max_in_flight"].get<size_t>());
+      }
+      if (metadata.contains("timeout_ms")) {
+        parse_timeout(metadata["timeout_ms"], policy.timeout);
+      }
+      policy.cancellable = ContainsMethod(name) && metadata.value("cancellable", false);
+      return policy;
+    }
+
+    const MethodHandle &find_method(const std::string &name) const {
+      auto method = methods.find(name);
+      if (method == methods.end()) {
+        throw JsonRpcException(method_not_found, "method not found: " + name);
+      }
+      return method->second;
+    }
+
+    json invoke_method(const std::string &name, const MethodHandle &method, const json &params) {
+      try {
+        return method(params);
+      } catch (json::type_error &e) {
+        throw JsonRpcException(invalid_params, name + ": invalid parameter (" + e.what() + ")");
+      } catch (JsonRpcException &e) {
+        throw process_type_error(name, e);
+      } catch (std::exception &e) {
+        // Exception type doesn't matter here
+        throw std::runtime_error(name + ": " + e.what());
+      }
+    }
 
     inline json normalize_parameter(const std::string &name, const json &params) {
       if (params.type() == json::value_t::array) {
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "codec.hpp"
+#include "common.hpp"
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace jsonrpccxx {
+  // Spans of the top-level members of a JSON-RPC response, empty if a member is absent.
+  // Values are located but not parsed.
+  struct ResponseEnvelope {
+    ResponseEnvelope() : id(), result(), error() {}
+    std::string_view id;
+    std::string_view result;
+    std::string_view error;
+  };
+
+  namespace envelope {
+    static inline void skip_whitespace(std::string_view text, size_t &pos) {
+      while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+        pos++;
+    }
+
+    // Moves pos behind the string starting at pos
+    static inline bool skip_string(std::string_view text, size_t &pos) {
+      for (pos++; pos < text.size(); pos++) {
+        if (text[pos] == '\\') {
+          pos++;
+        } else if (text[pos] == '"') {
+          pos++;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Moves pos behind the value starting at pos, checking bracket nesting only
+    static inline bool skip_value(std::string_view text, size_t &pos) {
+      if (pos >= text.size())
+        return false;
+      if (text[pos] == '"')
+        return skip_string(text, pos);
+      if (text[pos] == '{' || text[pos] == '[') {
+        size_t depth = 0;
+        while (pos < text.size()) {
+          char c = text[pos];
+          if (c == '"') {
+            if (!skip_string(text, pos))
+              return false;
+            continue;
+          }
+          if (c == '{' || c == '[') {
+            depth++;
+          } else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+              pos++;
+              return true;
+            }
+          }
+          pos++;
+        }
+        return false;
+      }
+      size_t start = pos;
+      while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']' && text[pos] != ' ' && text[pos] != '\t' && text[pos] != '\n' &&
+             text[pos] != '\r')
+        pos++;
+      return pos > start;
+    }
+  } // namespace envelope
+
+  namespace envelope {
+    // Calls member(key, value) for each member of the object text, keys are passed without quotes and
+    // unescaped. Returns false if text is not a single object, or member returned false.
+    template <typename F>
+    bool scan_object(std::string_view text, F &&member) {
+      size_t pos = 0;
+      skip_whitespace(text, pos);
+      if (pos >= text.size() || text[pos] != '{')
+        return false;
+      pos++;
+      skip_whitespace(text, pos);
+      if (pos < text.size() && text[pos] == '}') {
+        pos++;
+      } else {
+        while (true) {
+          skip_whitespace(text, pos);
+          if (pos >= text.size() || text[pos] != '"')
+            return false;
+          size_t keyStart = pos + 1;
+          if (!skip_string(text, pos))
+            return false;
+          std::string_view key = text.substr(keyStart, pos - keyStart - 1);
+          skip_whitespace(text, pos);
+          if (pos >= text.size() || text[pos] != ':')
+            return false;
+          pos++;
+          skip_whitespace(text, pos);
+          size_t valueStart = pos;
+          if (!skip_value(text, pos) || !member(key, text.substr(valueStart, pos - valueStart)))
+            return false;
+          skip_whitespace(text, pos);
+          if (pos < text.size() && text[pos] == ',') {
+            pos++;
+          } else if (pos < text.size() && text[pos] == '}') {
+            pos++;
+            break;
+          } else {
+            return false;
+          }
+        }
+      }
+      skip_whitespace(text, pos);
+      return pos == text.size();
+    }
+
+    // Calls element(value) for each element of the array text, same rules as scan_object
+    template <typename F>
+    bool scan_array(std::string_view text, F &&element) {
+      size_t pos = 0;
+      skip_whitespace(text, pos);
+      if (pos >= text.size() || text[pos] != '[')
+        return false;
+      pos++;
+      skip_whitespace(text, pos);
+      if (pos < text.size() && text[pos] == ']') {
+        pos++;
+      } else {
+        while (true) {
+          skip_whitespace(text, pos);
+          size_t valueStart = pos;
+          if (!skip_value(text, pos) || !element(text.substr(valueStart, pos - valueStart)))
+            return false;
+          skip_whitespace(text, pos);
+          if (pos < text.size() && text[pos] == ',') {
+            pos++;
+          } else if (pos < text.size() && text[pos] == ']') {
+            pos++;
+            break;
+          } else {
+            return false;
+          }
+        }
+      }
+      skip_whitespace(text, pos);
+      return pos == text.size();
+    }
+
+    // Content of a string literal without escape sequences, false for anything else
+    static inline bool plain_string(std::string_view text, std::string_view &content) {
+      if (text.size() < 2 || text.front() != '"' || text.back() != '"' || text.find('\\') != std::string_view::npos)
+        return false;
+      content = text.substr(1, text.size() - 2);
+      return true;
+    }
+
+    // Floating-point std::from_chars is missing from older libc++ (AppleClang among them), which only
+    // define __cpp_lib_to_chars once it is complete
+#if defined(__cpp_lib_to_chars)
+    static constexpr bool float_from_chars = true;
+#else
+    static constexpr bool float_from_chars = false;
+#endif
+
+    // Reads a number spanning all of text. Returns false if it does not, or for floating-point
+    // values without from_chars; decode_json then hands them to the json parser.
+    template <typename T>
+    static inline bool read_number(std::string_view text, T &value) {
+      if constexpr (std::is_floating_point<T>::value && !float_from_chars) {
+        return false;
+      } else {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+      }
+    }
+
+    template <typename T>
+    struct is_vector : std::false_type {};
+    template <typename T, typename Allocator>
+    struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+  } // namespace envelope
+
+  // Locates id, result and error of a response object. Returns false if text is not a single object,
+  // callers then fall back to a full parse for proper error reporting.
+  static inline bool scan_response(std::string_view text, ResponseEnvelope &envelope) {
+    return envelope::scan_object(text, [&envelope](std::string_view key, std::string_view value) {
+      if (key == "id")
+        envelope.id = value;
+      else if (key == "result")
+        envelope.result = value;
+      else if (key == "error")
+        envelope.error = value;
+      return true;
+    });
+  }
+
+  // Decodes a JSON value into T. Numbers, booleans, strings without escapes, vectors and types declared
+  // with JSONRPCCXX_STRUCT or JSONRPCCXX_ENUM are read straight from the text, anything else (or any
+  // text these readers reject) is parsed into a json value of its own first.
+  template <typename T>
+  T decode_json(std::string_view text) {
+    if constexpr (std::is_same<T, bool>::value) {
+      if (text == "true")
+        return true;
+      if (text == "false")
+        return false;
+    } else if constexpr (std::is_integral<T>::value || std::is_floating_point<T>::value) {
+      T value;
+      if (envelope::read_number(text, value))
+        return value;
+    } else if constexpr (std::is_same<T, std::string>::value) {
+      std::string_view content;
+      if (envelope::plain_string(text, content))
+        return std::string(content);
+    } else if constexpr (std::is_same<T, json>::value) {
+      return json::parse(text);
+    } else if constexpr (has_enum_names<T>::value) {
+      std::string_view content;
+      T value{};
+      if (envelope::plain_string(text, content) && enum_from_name(content, value))
+        return value;
+    } else if constexpr (has_fields<T>::value) {
+      T value{};
+      uint64_t seen = 0;
+      bool plain = envelope::scan_object(text, [&value, &seen](std::string_view key, std::string_view member) {
+        if (key.find('\\') != std::string_view::npos)
+          return false;
+        visit_field<T>(key, [&](const auto &field, size_t index) {
+          value.*(field.member) = decode_json<typename std::decay_t<decltype(field)>::type>(member);
+          seen |= 1ull << index;
+        });
+        return true;
+      });
+      if (plain) {
+        if (seen != all_fields<T>())
+          throw_missing_field<T>(seen);
+        return value;
+      }
+    } else if constexpr (envelope::is_vector<T>::value) {
+      T values;
+      bool plain = envelope::scan_array(text, [&values](std::string_view element) {
+        values.push_back(decode_json<typename T::value_type>(element));
+        return true;
+      });
+      if (plain)
+        return values;
+    }
+    return json::parse(text).get<T>();
+  }
+} // namespace jsonrpccxx
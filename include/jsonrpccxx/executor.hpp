@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jsonrpccxx {
+  // Decides where a server runs method handlers. Implementations must run every task exactly once,
+  // tasks must not throw.
+  class IExecutor {
+  public:
+    virtual ~IExecutor() = default;
+    virtual void Execute(std::function<void()> task) = 0;
+  };
+
+  // Runs tasks immediately on the calling thread (the default)
+  class InlineExecutor : public IExecutor {
+  public:
+    void Execute(std::function<void()> task) override { task(); }
+  };
+
+  // Fixed number of threads sharing one FIFO queue. Pending tasks are finished on destruction.
+  class ThreadPoolExecutor : public IExecutor {
+  public:
+    explicit ThreadPoolExecutor(size_t threads = std::max(std::thread::hardware_concurrency(), 1u)) : mutex(), cv(), tasks(), stopping(false), workers() {
+      for (size_t i = 0; i < std::max<size_t>(threads, 1); i++) {
+        workers.emplace_back([this]() { run(); });
+      }
+    }
+
+    ~ThreadPoolExecutor() override {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      cv.notify_all();
+      for (auto &worker : workers) {
+        worker.join();
+      }
+    }
+
+    void Execute(std::function<void()> task) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+      }
+      cv.notify_one();
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    bool stopping;
+    std::vector<std::thread> workers;
+
+    void run() {
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+          if (tasks.empty()) {
+            return;
+          }
+          task = std::move(tasks.front());
+          tasks.pop_front();
+        }
+        task();
+      }
+    }
+  };
+
+  // One queue per thread. Tasks submitted from a worker go to its own queue and are taken newest first,
+  // idle workers steal the oldest tasks from other queues. Pending tasks are finished on destruction.
+  class WorkStealingExecutor : public IExecutor {
+  public:
+    explicit WorkStealingExecutor(size_t threads = std::max(std::thread::hardware_concurrency(), 1u))
+        : queues(), workers(), mutex(), cv(), pending(0), stopping(false), next(0) {
+      threads = std::max<size_t>(threads, 1);
+      for (size_t i = 0; i < threads; i++) {
+        queues.emplace_back(new Queue());
+      }
+      for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back([this, i]() { run(i); });
+      }
+    }
+
+    ~WorkStealingExecutor() override {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      cv.notify_all();
+      for (auto &worker : workers) {
+        worker.join();
+      }
+    }
+
+    void Execute(std::function<void()> task) override {
+      size_t index = (owner == this) ? ownerIndex : next++ % queues.size();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++;
+      }
+      {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+      }
+      cv.notify_one();
+    }
+
+  private:
+    struct Queue {
+      Queue() : mutex(), tasks() {}
+      std::mutex mutex;
+      std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<size_t> pending;
+    bool stopping;
+    std::atomic<size_t> next;
+
+    inline static thread_local WorkStealingExecutor *owner = nullptr;
+    inline static thread_local size_t ownerIndex = 0;
+
+    bool take(size_t index, std::function<void()> &task) {
+      {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        if (!queues[index]->tasks.empty()) {
+          task = std::move(queues[index]->tasks.back());
+          queues[index]->tasks.pop_back();
+          return true;
+        }
+      }
+      for (size_t i = 1; i < queues.size(); i++) {
+        Queue &victim = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+          task = std::move(victim.tasks.front());
+          victim.tasks.pop_front();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void run(size_t index) {
+      owner = this;
+      ownerIndex = index;
+      while (true) {
+        std::function<void()> task;
+        if (take(index, task)) {
+          pending--;
+          task();
+          continue;
+        }
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [this]() { return stopping || pending > 0; });
+          if (stopping && pending == 0) {
+            return;
+          }
+        }
+        // A task is announced but not yet pushed, or just taken by another worker
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  // Runs posted tasks one at a time, in posting order, for handlers that are not thread-safe.
+  // A task runs on the executor it was posted with (inline for nullptr) once all earlier tasks completed.
+  // Tasks arriving while the strand is busy are queued; this contention is counted. After its own
+  // task, a thread only runs the tasks that were queued by then. The rest goes to a new turn on its
+  // executor or, inline, to the next thread that posts, which waits for the running task and takes over.
+  class Strand : public std::enable_shared_from_this<Strand> {
+  public:
+    Strand()
+        : mutex(), handover(), tasks(), running(false), exhausted(false), handedOver(false), waiting(0), executed(0), contended(0), maxQueue(0),
+          waitTime(0) {}
+
+    void Post(IExecutor *target, std::function<void()> task) {
+      bool takeOver = false;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (running) {
+          tasks.push_back(Queued{target, std::move(task), std::chrono::steady_clock::now()});
+          contended++;
+          maxQueue = std::max(maxQueue, tasks.size());
+          if (target != nullptr || !exhausted)
+            return;
+          waiting++;
+          handover.wait(lock, [this]() { return handedOver; });
+          handedOver = false;
+          waiting--;
+          takeOver = true;
+        } else {
+          running = true;
+        }
+      }
+      if (takeOver) {
+        // The task is queued behind the ones still waiting
+        drain(nullptr);
+      } else {
+        run(target, std::move(task));
+      }
+    }
+
+    size_t Executed() const { return executed; }
+    size_t Contended() const { return contended; }
+    size_t MaxQueue() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return maxQueue;
+    }
+    // Accumulated time tasks spent queued behind other tasks of the strand
+    std::chrono::microseconds WaitTime() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return std::chrono::duration_cast<std::chrono::microseconds>(waitTime);
+    }
+
+  private:
+    struct Queued {
+      IExecutor *target;
+      std::function<void()> task;
+      std::chrono::steady_clock::time_point queued;
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable handover;
+    std::deque<Queued> tasks;
+    bool running;
+    // The inline drain ran its share, posting threads wait to take over
+    bool exhausted;
+    bool handedOver;
+    size_t waiting;
+    std::atomic<size_t> executed;
+    std::atomic<size_t> contended;
+    size_t maxQueue;
+    std::chrono::steady_clock::duration waitTime;
+
+    void run(IExecutor *target, std::function<void()> task) {
+      if (target == nullptr) {
+        task();
+        executed++;
+        drain(nullptr);
+      } else {
+        target->Execute([self = shared_from_this(), target, task = std::move(task)]() {
+          task();
+          self->executed++;
+          self->drain(target);
+        });
+      }
+    }
+
+    // Continues with queued tasks on the current thread as long as they allow it and the budget
+    // lasts, hands over to another executor or thread otherwise.
+    void drain(IExecutor *current) {
+      size_t budget;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = tasks.size();
+        exhausted = false;
+      }
+      while (true) {
+        Queued next{nullptr, {}, {}};
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (waiting > 0 && (budget == 0 || tasks.empty())) {
+            handedOver = true;
+            handover.notify_one();
+            return;
+          }
+          if (tasks.empty()) {
+            running = false;
+            return;
+          }
+          if (budget == 0 && current != nullptr) {
+            break;
+          }
+          if (budget > 0) {
+            budget--;
+          } else {
+            exhausted = true;
+          }
+          next = std::move(tasks.front());
+          tasks.pop_front();
+          waitTime += std::chrono::steady_clock::now() - next.queued;
+        }
+        if (next.target != nullptr && next.target != current) {
+          run(next.target, std::move(next.task));
+          return;
+        }
+        next.task();
+        executed++;
+      }
+      // Lets the executor's other work in before the strand's next share
+      current->Execute([self = shared_from_this(), current]() { self->drain(current); });
+    }
+  };
+} // namespace jsonrpccxx
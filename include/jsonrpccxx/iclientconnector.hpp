@@ -1,4 +1,6 @@
 #pragma once
+#include <functional>
+#include <nlohmann/json.hpp>
 #include <string>
 
 namespace jsonrpccxx {
@@ -6,5 +8,27 @@ namespace jsonrpccxx {
     public:
         virtual ~IClientConnector() = default;
         virtual std::string Send(const std::string &request) = 0;
+        // Sends request and stores the answer in response, a buffer owned by the caller that keeps its
+        // capacity across calls. The default passes the request on to Send without copying it,
+        // transports override it to receive into response directly.
+        virtual void SendInto(const std::string &request, std::string &response) { response = Send(request); }
+    };
+
+    // In-process transport that hands requests to the server as objects. A JsonRpcClient whose
+    // IClientConnector also implements this interface sends calls and notifications through Call
+    // instead of serializing them. Returns the response object, null for notifications.
+    class IDirectClientConnector {
+    public:
+        virtual ~IDirectClientConnector() = default;
+        virtual nlohmann::json Call(nlohmann::json request) = 0;
+    };
+
+    // Transport that sends without waiting for an answer. Every message received from the server
+    // (responses or batch responses, in any order) is passed to the message handler.
+    class IAsyncClientConnector {
+    public:
+        virtual ~IAsyncClientConnector() = default;
+        virtual void Send(const std::string &request) = 0;
+        virtual void SetMessageHandler(std::function<void(const std::string &)> handler) = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "asyncclient.hpp"
+#include "envelope.hpp"
+#include "iclientconnector.hpp"
+#include "server.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace jsonrpccxx {
+  // JSON-RPC 2.0 endpoint that serves and calls over one duplex IAsyncClientConnector, so that two
+  // sides which both offer methods need a single connection. Incoming messages are told apart by
+  // their shape: objects with a "method" member (and batches starting with one) are requests for
+  // Server(), everything else is a response for the pending calls of Client(). Both sides number
+  // their calls independently, ids only have to be unique per direction. Notifications sent through
+  // Client() are pushed to the other side without expecting an answer.
+  //
+  // Handlers run on executor, or on a thread pool owned by the peer if none is given, never on the
+  // transport's reader thread, so they may wait for calls they make through Client(). An
+  // InlineExecutor runs them on the reader thread instead: a handler waiting there for a response
+  // blocks the thread that would deliver it and deadlocks.
+  class JsonRpcPeer {
+  public:
+    explicit JsonRpcPeer(IAsyncClientConnector &transport, std::shared_ptr<IExecutor> executor = nullptr)
+        : transport(transport), scope(NewRequestScope()), server(), outgoing(transport), client(outgoing),
+          pool(executor ? nullptr : std::make_unique<ThreadPoolExecutor>()) {
+      // The peer's own pool is joined in its destructor, before the server goes away
+      server.SetExecutor(executor ? std::move(executor) : std::shared_ptr<IExecutor>(pool.get(), [](IExecutor *) {}));
+      transport.SetMessageHandler([this](const std::string &message) { HandleMessage(message); });
+    }
+
+    // The transport must not deliver messages afterwards. Calls still pending fail, which releases
+    // handlers waiting for them, calls made later by handlers still running fail right away, and
+    // those handlers are waited for if they run on the peer's own pool.
+    ~JsonRpcPeer() {
+      transport.SetMessageHandler(nullptr);
+      client.Close(JsonRpcException(internal_error, "peer destroyed before a response arrived"));
+    }
+
+    JsonRpcPeer(const JsonRpcPeer &) = delete;
+    JsonRpcPeer &operator=(const JsonRpcPeer &) = delete;
+
+    // Methods and notifications the other side may call
+    JsonRpc2Server &Server() { return server; }
+    // Calls and notifications to the other side
+    AsyncJsonRpcClient &Client() { return client; }
+
+    // Requests carry a "method" member, responses never do. Batches are classified by their first
+    // element; anything that is no object at all goes to the server, which answers with an error.
+    static bool IsRequest(std::string_view message) {
+      bool method = false;
+      auto member = [&method](std::string_view key, std::string_view) {
+        method = method || key == "method";
+        return true;
+      };
+      bool object = envelope::scan_object(message, member);
+      if (!object) {
+        envelope::scan_array(message, [&object, &member](std::string_view first) {
+          object = envelope::scan_object(first, member);
+          return false;
+        });
+      }
+      return !object || method;
+    }
+
+  private:
+    // The client's end of the transport: sends go straight out, responses are handed in by the peer
+    class Outgoing : public IAsyncClientConnector {
+    public:
+      explicit Outgoing(IAsyncClientConnector &transport) : transport(transport), handler() {}
+      void Send(const std::string &request) override { transport.Send(request); }
+      void SetMessageHandler(std::function<void(const std::string &)> handler) override { this->handler = std::move(handler); }
+      void Deliver(const std::string &response) {
+        if (handler)
+          handler(response);
+      }
+
+    private:
+      IAsyncClientConnector &transport;
+      std::function<void(const std::string &)> handler;
+    };
+
+    IAsyncClientConnector &transport;
+    RequestScope scope;
+    JsonRpc2Server server;
+    Outgoing outgoing;
+    AsyncJsonRpcClient client;
+    // Declared last so it is joined first, while the server and client are still alive
+    std::unique_ptr<ThreadPoolExecutor> pool;
+
+    void HandleMessage(const std::string &message) {
+      if (!IsRequest(message)) {
+        outgoing.Deliver(message);
+        return;
+      }
+      IAsyncClientConnector &out = transport;
+      server.HandleRequestAsync(
+          message,
+          [&out](std::string response) {
+            if (response.empty())
+              return;
+            try {
+              out.Send(response);
+            } catch (std::exception &) {
+              // The connection is gone, the other side will not wait for this response any more
+            }
+          },
+          scope);
+    }
+  };
+} // namespace jsonrpccxx
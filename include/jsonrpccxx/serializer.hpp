@@ -0,0 +1,97 @@
+#pragma once
+
+#include "codec.hpp"
+#include "common.hpp"
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace jsonrpccxx {
+  // Appends values in JSON form to a string without building a json DOM for the common cases
+  // (strings, integers, booleans, null, JSONRPCCXX_STRUCT and JSONRPCCXX_ENUM types). Anything else
+  // is converted through nlohmann::json.
+
+  static inline void append_json_string(std::string &out, std::string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+      auto c = static_cast<unsigned char>(value[i]);
+      if (c >= 0x20 && c != '"' && c != '\\') {
+        continue;
+      }
+      out.append(value.data() + start, i - start);
+      start = i + 1;
+      switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\b':
+        out += "\\b";
+        break;
+      case '\f':
+        out += "\\f";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        out += "\\u00";
+        out += hex[c >> 4];
+        out += hex[c & 0xf];
+      }
+    }
+    out.append(value.data() + start, value.size() - start);
+    out += '"';
+  }
+
+  template <typename T>
+  void append_json(std::string &out, const T &value) {
+    typedef typename std::decay<T>::type type;
+    if constexpr (std::is_same<type, bool>::value) {
+      out += value ? "true" : "false";
+    } else if constexpr (std::is_integral<type>::value) {
+      char buffer[24];
+      auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+      out.append(buffer, result.ptr);
+    } else if constexpr (std::is_same<type, std::nullptr_t>::value) {
+      out += "null";
+    } else if constexpr (std::is_convertible<const type &, std::string_view>::value && !std::is_same<type, json>::value) {
+      append_json_string(out, std::string_view(value));
+    } else if constexpr (std::is_same<type, json>::value) {
+      out += value.dump();
+    } else if constexpr (has_enum_names<type>::value) {
+      append_json_string(out, enum_to_name(value));
+    } else if constexpr (has_fields<type>::value) {
+      static constexpr auto fields = fields_of<type>();
+      out += '{';
+      std::apply(
+          [&](const auto &...field) {
+            bool first = true;
+            ((out += first ? "" : ",", first = false, append_json_string(out, field.name), out += ':', append_json(out, value.*(field.member))), ...);
+          },
+          fields);
+      out += '}';
+    } else {
+      out += json(value).dump();
+    }
+  }
+
+  // Appends "a,b,c" for the given values
+  template <typename... Args>
+  void append_json_list(std::string &out, const Args &...values) {
+    bool first = true;
+    ((out += first ? "" : ",", first = false, append_json(out, values)), ...);
+  }
+} // namespace jsonrpccxx
@@ -1,18 +1,71 @@
 #pragma once
 
+#include "buffer.hpp"
 #include "common.hpp"
+#include "context.hpp"
 #include "dispatcher.hpp"
+#include "executor.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 namespace jsonrpccxx {
+  // Receives the serialized response, an empty string if there is nothing to send back
+  typedef std::function<void(std::string)> ResponseCallback;
+  // Receives the response as segments, an empty buffer if there is nothing to send back
+  typedef std::function<void(ResponseBuffer)> BufferCallback;
+  // Receives the response object, null if there is nothing to send back
+  typedef std::function<void(json)> JsonCallback;
+
+  // Identifies the caller a request comes from, usually one per connection. rpc.cancel only reaches
+  // calls made in its own scope, so clients that happen to use the same ids cannot cancel each
+  // other's calls. Scope 0 is shared by all callers that do not pass one.
+  typedef uint64_t RequestScope;
+
+  // Returns a scope no other caller of this function gets
+  inline RequestScope NewRequestScope() {
+    static std::atomic<RequestScope> next(1);
+    return next++;
+  }
+
   class JsonRpcServer {
   public:
     JsonRpcServer() : dispatcher() {}
     virtual ~JsonRpcServer() = default;
     virtual std::string HandleRequest(const std::string &request) = 0;
 
+    // Invokes callback once the response is available, possibly on another thread
+    virtual void HandleRequestAsync(const std::string &request, ResponseCallback callback, RequestScope scope = 0) {
+      (void)scope;
+      callback(HandleRequest(request));
+    }
+
+    // Buffer based variants of the above: request only needs to stay valid until the call returns,
+    // the response comes as segments that transports can write without concatenating them. The
+    // defaults adapt the string API; JsonRpc2Server implements these natively and the string API on top.
+    virtual ResponseBuffer HandleBuffer(std::string_view request) { return HandleRequest(std::string(request)); }
+    virtual void HandleBufferAsync(std::string_view request, BufferCallback callback, RequestScope scope = 0) {
+      HandleRequestAsync(std::string(request), [callback = std::move(callback)](std::string response) { callback(std::move(response)); }, scope);
+    }
+
+    // DOM variants for in-process callers, which skip serializing the request and parsing the
+    // response. The default adapts the string API; JsonRpc2Server hands single requests to the
+    // dispatcher as they are, with the same validation and errors as on the wire.
+    virtual json HandleJson(json request) {
+      std::string response = HandleRequest(request.dump());
+      return response.empty() ? json() : json::parse(response);
+    }
+
     [[deprecated]] bool Add(const std::string &name, MethodHandle callback, const NamedParamMapping &mapping = NAMED_PARAM_MAPPING) {
       if (name.rfind("rpc.", 0) == 0)
         return false;
@@ -137,6 +190,28 @@ namespace jsonrpccxx {
       return dispatcher.Add(name, docstring, callback, mapping);
     }
 
+    // Registers a bulk method: within a batch, all calls to it are passed to one invocation of the handler.
+    template <typename Func>
+    inline bool AddBulk(
+      const std::string &name,
+      const std::string &docstring,
+      Func method,
+      const NamedParamMapping &args = NAMED_PARAM_MAPPING,
+      const NamedParamMapping &argDocstrings = NAMED_PARAM_MAPPING)
+    {
+      if (name.find("rpc.", 0) == 0)
+        return false;
+
+      return dispatcher.AddBulk(name, docstring, std::move(method), args, argDocstrings);
+    }
+
+    inline bool AddBulk(const std::string &name, const std::string &docstring, BulkHandle callback, const NamedParamMapping &mapping = NAMED_PARAM_MAPPING) {
+      if (name.find("rpc.", 0) == 0)
+        return false;
+
+      return dispatcher.AddBulk(name, docstring, std::move(callback), mapping);
+    }
+
     template <typename... ArgsType>
     inline void ForceAdd(
         const std::string &name,
@@ -202,68 +277,618 @@ namespace jsonrpccxx {
       return dispatcher.FilterMethodsByMetadata(filterMetadata);
     }
 
+    // Drops all cached results of a method registered with {"cacheable": true} metadata.
+    inline bool InvalidateCache(const std::string &name) {
+      return dispatcher.InvalidateCache(name);
+    }
+
+    virtual json Statistics() const {
+      return {{"cache", dispatcher.CacheStatistics()}, {"coalesced", dispatcher.CoalescingStatistics()}, {"strands", dispatcher.StrandStatistics()}};
+    }
+
   protected:
     Dispatcher dispatcher;
   };
 
   class JsonRpc2Server : public JsonRpcServer {
   public:
-    JsonRpc2Server() = default;
+    JsonRpc2Server() : executor(nullptr), executors(), inFlight(), shedder(), expired(0), cancellableMutex(), cancellable(), cancelled(0) {}
     ~JsonRpc2Server() override = default;
 
+    // Executor running all handlers without an "executor" metadata entry, inline by default.
+    // Executors must outlive the server, and must not be the thread calling the synchronous
+    // HandleRequest, since it blocks until the handlers completed.
+    void SetExecutor(std::shared_ptr<IExecutor> executor) {
+      this->executor = std::move(executor);
+    }
+
+    // Registers an executor that methods select through {"executor": name} metadata
+    bool AddExecutor(const std::string &name, std::shared_ptr<IExecutor> executor) {
+      return executors.emplace(name, std::move(executor)).second;
+    }
+
+    // Rejects calls while maxInFlight calls are running or queued, 0 disables the bound.
+    // Per-method bounds are set with {"max_in_flight": n} metadata. Calls in flight keep the bounds
+    // they were admitted under, replacing a bound only affects the calls that arrive afterwards.
+    void SetMaxInFlight(size_t maxInFlight) {
+      std::atomic_store(&inFlight, maxInFlight > 0 ? std::make_shared<InFlightLimit>(maxInFlight) : nullptr);
+    }
+
+    // Sheds calls that waited too long for their handler to start, see QueueDelayShedder. A zero target disables shedding.
+    // Calls already queued keep the shedder they were admitted under.
+    void SetQueueDelayTarget(std::chrono::microseconds target, std::chrono::microseconds interval = std::chrono::milliseconds(100)) {
+      std::atomic_store(&shedder, target.count() > 0 ? std::make_shared<QueueDelayShedder>(target, interval) : nullptr);
+    }
+
+    json Statistics() const override {
+      json stats = JsonRpcServer::Statistics();
+      json admission = {{"methods", dispatcher.AdmissionStatistics()}};
+      if (auto inFlight = std::atomic_load(&this->inFlight)) {
+        admission["in_flight"] = inFlight->InFlight();
+        admission["max_in_flight"] = inFlight->Limit();
+        admission["rejected"] = inFlight->Rejected();
+      }
+      if (auto shedder = std::atomic_load(&this->shedder)) {
+        admission["overloaded"] = shedder->Overloaded();
+        admission["shed"] = shedder->Shed();
+      }
+      stats["admission"] = std::move(admission);
+      stats["deadlines"] = {{"expired", expired.load()}};
+      stats["cancelled"] = cancelled.load();
+      return stats;
+    }
+
     std::string HandleRequest(json &request) {
-        if (request.is_array()) {
-          json result = json::array();
-          for (json &r : request) {
-            json res = this->HandleSingleRequest(r);
-            if (!res.is_null()) {
-              result.push_back(std::move(res));
-            }
+      Waiter<ResponseBuffer> waiter;
+      Dispatch(std::move(request), waiter.Callback(), 0);
+      return waiter.Wait().ToString();
+    }
+
+    std::string HandleRequest(const std::string &requestString) override { return HandleBuffer(requestString).ToString(); }
+
+    void HandleRequestAsync(const std::string &requestString, ResponseCallback callback, RequestScope scope = 0) override {
+      HandleBufferAsync(requestString, Adapt(std::move(callback)), scope);
+    }
+
+    void HandleRequestAsync(json request, ResponseCallback callback, RequestScope scope = 0) { Dispatch(std::move(request), Adapt(std::move(callback)), scope); }
+
+    ResponseBuffer HandleBuffer(std::string_view request) override {
+      Waiter<ResponseBuffer> waiter;
+      HandleBufferAsync(request, waiter.Callback());
+      return waiter.Wait();
+    }
+
+    void HandleBufferAsync(std::string_view requestString, BufferCallback callback, RequestScope scope = 0) override {
+      json request;
+      try {
+        request = json::parse(requestString.begin(), requestString.end());
+      } catch (json::parse_error &e) {
+        callback(json{{"id", nullptr}, {"error", {{"code", parse_error}, {"message", std::string("parse error: ") + e.what()}}}, {"jsonrpc", "2.0"}}.dump());
+        return;
+      }
+      Dispatch(std::move(request), std::move(callback), scope);
+    }
+
+    json HandleJson(json request) override {
+      Waiter<json> waiter;
+      HandleJsonAsync(std::move(request), waiter.Callback());
+      return waiter.Wait();
+    }
+
+    // Single requests go through admission control, executors and cancellation like any other, the
+    // handler's result is put into the response object without being serialized. Batches and
+    // rpc.cancel are rare in process and take the serialized path.
+    void HandleJsonAsync(json request, JsonCallback callback, RequestScope scope = 0) {
+      if (!request.is_object() || IsCancelRequest(request)) {
+        Dispatch(std::move(request), Parse(std::move(callback)), scope);
+        return;
+      }
+      if (RejectInvalidTimeout(request, [&](const JsonRpcException &e) { callback(RejectedResponse(request, e)); })) {
+        return;
+      }
+      const MethodPolicy *policy = PolicyFor(request);
+      auto deadline = DeadlineFor(request, policy);
+      auto call = CancellableFor(request, policy, Parse(callback), scope);
+      Admit(
+          policy, deadline, std::move(call),
+          [this, request = std::move(request)](const JsonRpcException *rejection) mutable {
+            return rejection != nullptr ? RejectedResponse(request, *rejection) : HandleSingleRequestJson(request);
+          },
+          std::move(callback));
+    }
+
+  private:
+    static BufferCallback Adapt(ResponseCallback callback) {
+      return [callback = std::move(callback)](ResponseBuffer response) { callback(std::move(response).ToString()); };
+    }
+
+    static BufferCallback Parse(JsonCallback callback) {
+      return [callback = std::move(callback)](ResponseBuffer response) { callback(response.Empty() ? json() : json::parse(std::move(response).ToString())); };
+    }
+
+    void Dispatch(json request, BufferCallback callback, RequestScope scope) {
+      if (request.is_array()) {
+        HandleBatchAsync(std::move(request), std::move(callback), scope);
+      } else if (request.is_object()) {
+        if (IsCancelRequest(request)) {
+          callback(HandleCancelRequest(request, scope));
+          return;
+        }
+        if (RejectInvalidTimeout(request, [&](const JsonRpcException &e) { callback(BuildRejectedResponse(request, e)); })) {
+          return;
+        }
+        const MethodPolicy *policy = PolicyFor(request);
+        auto deadline = DeadlineFor(request, policy);
+        auto call = CancellableFor(request, policy, callback, scope);
+        Admit(
+            policy, deadline, std::move(call),
+            [this, request = std::move(request)](const JsonRpcException *rejection) mutable {
+              return rejection != nullptr ? BuildRejectedResponse(request, *rejection) : HandleSingleRequest(request);
+            },
+            std::move(callback));
+      } else {
+        callback(json{{"id", nullptr}, {"error", {{"code", invalid_request}, {"message", "invalid request: expected array or object"}}}, {"jsonrpc", "2.0"}}.dump());
+      }
+    }
+
+    // A queued or running call of a {"cancellable": true} method, registered by scope and id for
+    // rpc.cancel. Whoever answers first, the handler or the cancellation, releases the call's slots.
+    struct CancellableCall {
+      CancellableCall(RequestScope scope, json id, BufferCallback respond)
+          : key(Key(scope, id)), id(std::move(id)), respond(std::move(respond)), token(), answered(false), globalLimit(), methodLimit() {}
+      CancellableCall(const CancellableCall &) = delete;
+      CancellableCall &operator=(const CancellableCall &) = delete;
+      std::string key;
+      json id;
+      BufferCallback respond;
+      CancellationToken token;
+      std::atomic<bool> answered;
+      std::shared_ptr<InFlightLimit> globalLimit;
+      std::shared_ptr<InFlightLimit> methodLimit;
+
+      // Returns false if the call was already answered
+      bool Answer() { return !answered.exchange(true); }
+
+      static std::string Key(RequestScope scope, const json &id) { return std::to_string(scope) + ':' + id.dump(); }
+    };
+
+    std::shared_ptr<IExecutor> executor;
+    std::map<std::string, std::shared_ptr<IExecutor>> executors;
+    // Replaced by SetMaxInFlight while calls may hold the previous limit, accessed atomically
+    std::shared_ptr<InFlightLimit> inFlight;
+    std::shared_ptr<QueueDelayShedder> shedder;
+    std::atomic<size_t> expired;
+    std::mutex cancellableMutex;
+    std::unordered_multimap<std::string, std::shared_ptr<CancellableCall>> cancellable;
+    std::atomic<size_t> cancelled;
+
+    // Lets the synchronous HandleRequest block until the asynchronous path answered
+    template <typename Response>
+    class Waiter {
+    public:
+      Waiter() : state(std::make_shared<State>()) {}
+
+      std::function<void(Response)> Callback() {
+        return [state = this->state](Response response) {
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->response = std::move(response);
+            state->done = true;
+          }
+          state->cv.notify_one();
+        };
+      }
+
+      Response Wait() {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock, [this]() { return state->done; });
+        return std::move(state->response);
+      }
+
+    private:
+      struct State {
+        State() : mutex(), cv(), done(false), response() {}
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done;
+        Response response;
+      };
+      std::shared_ptr<State> state;
+    };
+
+    // Shared by all tasks of one batch, the last one to finish sends the response
+    struct BatchCall {
+      BatchCall(json &&request, BufferCallback &&callback)
+          : request(std::move(request)), responses(this->request.size()), pending(1), memo(), callback(std::move(callback)) {}
+      json request;
+      std::vector<ResponseBuffer> responses;
+      std::atomic<size_t> pending;
+      CallMemo memo;
+      BufferCallback callback;
+    };
+
+    const MethodPolicy *PolicyFor(const json &request) const {
+      if (!has_key_type(request, "method", json::value_t::string)) {
+        return nullptr;
+      }
+      return dispatcher.Policy(request["method"].get_ref<const std::string &>());
+    }
+
+    // Returns nullptr if the handler should run inline
+    IExecutor *ExecutorFor(const MethodPolicy *policy) const {
+      IExecutor *target = executor.get();
+      if (policy != nullptr && !policy->executor.empty()) {
+        auto named = executors.find(policy->executor);
+        if (named != executors.end()) {
+          target = named->second.get();
+        }
+      }
+      return dynamic_cast<InlineExecutor *>(target) != nullptr ? nullptr : target;
+    }
+
+    // Runs task on the method's executor, serialized on its strand if it has one
+    template <typename Task>
+    void Schedule(const MethodPolicy *policy, Task &&task) {
+      IExecutor *target = ExecutorFor(policy);
+      if (policy != nullptr && policy->strand) {
+        policy->strand->Post(target, std::forward<Task>(task));
+      } else if (target == nullptr) {
+        task();
+      } else {
+        target->Execute(std::forward<Task>(task));
+      }
+    }
+
+    std::shared_ptr<CancellableCall> CancellableFor(const json &request, const MethodPolicy *policy, const BufferCallback &respond, RequestScope scope) const {
+      if (policy == nullptr || !policy->cancellable || !valid_id_not_null(request)) {
+        return nullptr;
+      }
+      return std::make_shared<CancellableCall>(scope, request["id"], respond);
+    }
+
+    static void Release(const std::shared_ptr<InFlightLimit> &globalLimit, const std::shared_ptr<InFlightLimit> &methodLimit) {
+      if (methodLimit)
+        methodLimit->Release();
+      if (globalLimit)
+        globalLimit->Release();
+    }
+
+    // Admission control: run(nullptr) is scheduled if the call is admitted, run(&rejection) is called
+    // instead if it is rejected, shed or expired. done receives run's result once the call released its slots,
+    // unless a cancellation answered the call first.
+    template <typename Run, typename Done>
+    void Admit(const MethodPolicy *policy, RequestContext::clock::time_point deadline, std::shared_ptr<CancellableCall> call, Run &&run, Done &&done) {
+      // Admitted calls own the limits they acquired and their shedder, which outlive SetMaxInFlight, SetQueueDelayTarget,
+      // AddMethodMetadata and Remove
+      std::shared_ptr<InFlightLimit> globalLimit = std::atomic_load(&inFlight);
+      std::shared_ptr<InFlightLimit> methodLimit = policy != nullptr ? policy->limit : nullptr;
+      if (globalLimit && !globalLimit->TryAcquire()) {
+        JsonRpcException rejection = overloaded_exception("too many calls in flight");
+        done(run(&rejection));
+        return;
+      }
+      if (methodLimit && !methodLimit->TryAcquire()) {
+        if (globalLimit)
+          globalLimit->Release();
+        JsonRpcException rejection = overloaded_exception("too many calls of this method in flight");
+        done(run(&rejection));
+        return;
+      }
+      if (call) {
+        call->globalLimit = globalLimit;
+        call->methodLimit = methodLimit;
+        std::lock_guard<std::mutex> lock(cancellableMutex);
+        cancellable.emplace(call->key, call);
+      }
+      std::shared_ptr<QueueDelayShedder> shedder = std::atomic_load(&this->shedder);
+      auto admitted = shedder ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+      Schedule(policy, [this, globalLimit = std::move(globalLimit), methodLimit = std::move(methodLimit), shedder = std::move(shedder), deadline, admitted,
+                        call = std::move(call), run = std::forward<Run>(run), done = std::forward<Done>(done)]() mutable {
+        if (call && call->token.Cancelled()) {
+          // Cancelled while queued, rpc.cancel already answered and released the call
+          Unregister(call);
+          return;
+        }
+        RequestContext context(deadline, call ? &call->token : nullptr);
+        RequestContext::Scope scope(context);
+        auto result = [&]() {
+          if (context.Expired()) {
+            expired++;
+            JsonRpcException rejection(deadline_exceeded, "deadline exceeded before the call started");
+            return run(&rejection);
           }
-          return result.dump();
-        } else if (request.is_object()) {
-          json res = HandleSingleRequest(request);
-          if (!res.is_null()) {
-            return res.dump();
-          } else {
-            return "";
+          if (shedder && shedder->ShouldShed(std::chrono::steady_clock::now() - admitted)) {
+            JsonRpcException rejection = overloaded_exception("call queued for too long");
+            return run(&rejection);
           }
-        } else {
-          return json{{"id", nullptr}, {"error", {{"code", invalid_request}, {"message", "invalid request: expected array or object"}}}, {"jsonrpc", "2.0"}}.dump();
+          return run(nullptr);
+        }();
+        if (call) {
+          Unregister(call);
+          if (!call->Answer()) {
+            return;
+          }
+        }
+        Release(globalLimit, methodLimit);
+        done(std::move(result));
+      });
+    }
+
+    void Unregister(const std::shared_ptr<CancellableCall> &call) {
+      std::lock_guard<std::mutex> lock(cancellableMutex);
+      auto range = cancellable.equal_range(call->key);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == call) {
+          cancellable.erase(it);
+          return;
         }
+      }
+    }
+
+    static bool IsCancelRequest(const json &request) {
+      return request.is_object() && has_key_type(request, "method", json::value_t::string) && request["method"].get_ref<const std::string &>() == "rpc.cancel";
     }
 
-    std::string HandleRequest(const std::string &requestString) override {
+    // rpc.cancel takes the id of the call to cancel, by position or as "id", and only finds calls made
+    // in the same scope. It bypasses admission control and executors, cancelled calls are answered
+    // with request_cancelled right away.
+    ResponseBuffer HandleCancelRequest(json &request, RequestScope scope) {
       try {
-        json request = json::parse(requestString);
-        return HandleRequest(request);
-      } catch (json::parse_error &e) {
-        return json{{"id", nullptr}, {"error", {{"code", parse_error}, {"message", std::string("parse error: ") + e.what()}}}, {"jsonrpc", "2.0"}}.dump();
+        ValidateRequest(request);
+        const json &params = request["params"];
+        json target;
+        if (params.is_array() && params.size() == 1) {
+          target = params[0];
+        } else if (params.is_object() && has_key(params, "id")) {
+          target = params["id"];
+        } else {
+          throw JsonRpcException(invalid_params, "invalid parameter: rpc.cancel expects the id of the call to cancel");
+        }
+        std::vector<std::shared_ptr<CancellableCall>> calls;
+        {
+          std::lock_guard<std::mutex> lock(cancellableMutex);
+          auto range = cancellable.equal_range(CancellableCall::Key(scope, target));
+          for (auto it = range.first; it != range.second; ++it) {
+            calls.push_back(it->second);
+          }
+        }
+        for (auto &call : calls) {
+          call->token.Cancel();
+          if (call->Answer()) {
+            cancelled++;
+            Release(call->globalLimit, call->methodLimit);
+            call->respond(BuildErrorResponse(call->id, JsonRpcException(request_cancelled, "request cancelled")));
+          }
+        }
+        return has_key(request, "id") ? BuildResultResponse(request["id"], calls.empty() ? "false" : "true") : ResponseBuffer();
+      } catch (JsonRpcException &e) {
+        return has_key(request, "id") ? BuildErrorResponse(valid_id(request) ? request["id"] : json(nullptr), e) : ResponseBuffer();
       }
     }
 
-  private:
-    json HandleSingleRequest(json &request) {
+    // Deadline from the request's "timeout_ms" member, or else the method's {"timeout_ms": n}
+    // metadata. Both are at most max_timeout_ms, and 0 means no deadline in either place. Requests
+    // with an invalid member are answered by RejectInvalidTimeout before they get here.
+    RequestContext::clock::time_point DeadlineFor(const json &request, const MethodPolicy *policy) const {
+      std::chrono::milliseconds timeout(0);
+      if (request.is_object() && has_key(request, "timeout_ms")) {
+        parse_timeout(request["timeout_ms"], timeout);
+      } else if (policy != nullptr) {
+        timeout = policy->timeout;
+      }
+      if (timeout.count() == 0) {
+        return RequestContext::clock::time_point::max();
+      }
+      return RequestContext::clock::now() + timeout;
+    }
+
+    static JsonRpcException InvalidTimeout() { return JsonRpcException(invalid_params, "invalid params: timeout_ms must be a non-negative integer"); }
+
+    // Requests with an invalid "timeout_ms" member are answered with invalid_params right away,
+    // without taking admission slots or waiting for an executor. Returns true if request was one.
+    template <typename Respond>
+    static bool RejectInvalidTimeout(const json &request, Respond &&respond) {
+      std::chrono::milliseconds timeout(0);
+      if (!request.is_object() || !has_key(request, "timeout_ms") || parse_timeout(request["timeout_ms"], timeout)) {
+        return false;
+      }
+      respond(InvalidTimeout());
+      return true;
+    }
+
+    void HandleBatchAsync(json &&request, BufferCallback &&callback, RequestScope scope) {
+      auto batch = std::make_shared<BatchCall>(std::move(request), std::move(callback));
+      std::map<std::string, std::vector<size_t>> bulkCalls;
+      for (size_t i = 0; i < batch->request.size(); i++) {
+        json &r = batch->request[i];
+        if (dispatcher.HasBulkMethods() && IsBulkCall(r)) {
+          bulkCalls[r["method"]].push_back(i);
+          continue;
+        }
+        if (IsCancelRequest(r)) {
+          batch->responses[i] = HandleCancelRequest(r, scope);
+          continue;
+        }
+        if (RejectInvalidTimeout(r, [&](const JsonRpcException &e) { batch->responses[i] = BuildRejectedResponse(r, e); })) {
+          continue;
+        }
+        batch->pending++;
+        const MethodPolicy *policy = PolicyFor(r);
+        auto done = [this, batch, i](ResponseBuffer response) {
+          batch->responses[i] = std::move(response);
+          CompleteBatch(batch);
+        };
+        Admit(
+            policy, DeadlineFor(r, policy), CancellableFor(r, policy, done, scope),
+            [this, batch, i](const JsonRpcException *rejection) {
+              json &element = batch->request[i];
+              return rejection != nullptr ? BuildRejectedResponse(element, *rejection) : HandleSingleRequest(element, &batch->memo);
+            },
+            done);
+      }
+      for (auto &[name, indexes] : bulkCalls) {
+        // Bulk invocations serve several calls at once and run without a deadline
+        batch->pending++;
+        Admit(
+            dispatcher.Policy(name), RequestContext::clock::time_point::max(), nullptr,
+            [this, batch, name = name, indexes = std::move(indexes)](const JsonRpcException *rejection) {
+              if (rejection != nullptr) {
+                for (size_t i : indexes) {
+                  batch->responses[i] = BuildErrorResponse(batch->request[i]["id"], *rejection);
+                }
+              } else {
+                HandleBulkCall(name, batch->request, indexes, batch->responses);
+              }
+              return 0;
+            },
+            [this, batch](int) { CompleteBatch(batch); });
+      }
+      CompleteBatch(batch);
+    }
+
+    void CompleteBatch(const std::shared_ptr<BatchCall> &batch) {
+      if (--batch->pending > 0) {
+        return;
+      }
+      // The responses become segments of the batch response, without copying them
+      ResponseBuffer result;
+      result.AppendStatic("[");
+      bool first = true;
+      for (ResponseBuffer &res : batch->responses) {
+        if (!res.Empty()) {
+          if (!first) {
+            result.AppendStatic(",");
+          }
+          first = false;
+          result.Append(std::move(res));
+        }
+      }
+      result.AppendStatic("]");
+      batch->callback(std::move(result));
+    }
+
+    // Returns the serialized response, or an empty buffer for notifications
+    ResponseBuffer HandleSingleRequest(json &request, CallMemo *memo = nullptr) {
+      return HandleSingle(
+          request, [this, memo](json &r) { return BuildResultResponse(r["id"], dispatcher.InvokeMethodSerialized(r["method"], r["params"], memo)); },
+          [](const json &id, const JsonRpcException &e) { return ResponseBuffer(BuildErrorResponse(id, e)); });
+    }
+
+    // HandleSingleRequest for in-process callers, the response as object (null for notifications)
+    json HandleSingleRequestJson(json &request) {
+      return HandleSingle(
+          request, [this](json &r) { return json{{"id", r["id"]}, {"jsonrpc", "2.0"}, {"result", dispatcher.InvokeMethodDirect(r["method"], r["params"])}}; },
+          &ErrorResponse);
+    }
+
+    // Validation, notifications and errors shared by both of the above, so that the direct path
+    // answers exactly like the wire path. invoke answers a valid method call, error builds error
+    // responses; notifications get an empty response.
+    template <typename Invoke, typename Error>
+    auto HandleSingle(json &request, Invoke &&invoke, Error &&error) -> decltype(invoke(request)) {
       json id = nullptr;
       if (valid_id(request)) {
         id = request["id"];
       }
       try {
-        return ProcessSingleRequest(request);
-      } catch (JsonRpcException &e) {
-        json error = {{"code", e.Code()}, {"message", e.Message()}};
-        if (!e.Data().is_null()) {
-          error["data"] = e.Data();
+        ValidateRequest(request);
+        if (!has_key(request, "id")) {
+          try {
+            dispatcher.InvokeNotification(request["method"], request["params"]);
+          } catch (std::exception &) {
+          }
+          return {};
         }
-        return json{{"id", id}, {"error", error}, {"jsonrpc", "2.0"}};
+        return invoke(request);
+      } catch (JsonRpcException &e) {
+        return error(id, e);
       } catch (std::exception &e) {
-        return json{{"id", id}, {"error", {{"code", internal_error}, {"message", std::string("internal server error: ") + e.what()}}}, {"jsonrpc", "2.0"}};
+        return error(id, JsonRpcException(internal_error, std::string("internal server error: ") + e.what()));
+      } catch (...) {
+        return error(id, JsonRpcException(internal_error, "internal server error"));
+      }
+    }
+
+    // Produces the same bytes as dumping {"id": id, "jsonrpc": "2.0", "result": result}, as an
+    // envelope prefix, the already serialized result and the closing brace.
+    static ResponseBuffer BuildResultResponse(const json &id, std::string result) {
+      std::string prefix = "{\"id\":";
+      prefix += id.dump();
+      prefix += ",\"jsonrpc\":\"2.0\",\"result\":";
+      ResponseBuffer response;
+      response.Append(std::move(prefix));
+      response.Append(std::move(result));
+      response.AppendStatic("}");
+      return response;
+    }
+
+    // Notifications are dropped silently
+    static ResponseBuffer BuildRejectedResponse(const json &request, const JsonRpcException &e) {
+      if (!has_key(request, "id")) {
+        return ResponseBuffer();
+      }
+      return BuildErrorResponse(valid_id(request) ? request["id"] : json(nullptr), e);
+    }
+
+    static json RejectedResponse(const json &request, const JsonRpcException &e) {
+      if (!has_key(request, "id")) {
+        return json();
+      }
+      return ErrorResponse(valid_id(request) ? request["id"] : json(nullptr), e);
+    }
+
+    static std::string BuildErrorResponse(const json &id, const JsonRpcException &e) { return ErrorResponse(id, e).dump(); }
+
+    static json ErrorResponse(const json &id, const JsonRpcException &e) {
+      json error = {{"code", e.Code()}, {"message", e.Message()}};
+      if (!e.Data().is_null()) {
+        error["data"] = e.Data();
+      }
+      return json{{"id", id}, {"error", error}, {"jsonrpc", "2.0"}};
+    }
+
+    // Valid method calls (not notifications) to bulk methods are grouped per batch; anything else,
+    // including invalid requests, goes through the regular path.
+    bool IsBulkCall(json &request) {
+      if (!request.is_object() || !has_key(request, "id") || !has_key_type(request, "method", json::value_t::string) ||
+          !dispatcher.ContainsBulk(request["method"])) {
+        return false;
+      }
+      try {
+        ValidateRequest(request);
+        return true;
+      } catch (JsonRpcException &) {
+        return false;
+      }
+    }
+
+    void HandleBulkCall(const std::string &name, json &batch, const std::vector<size_t> &indexes, std::vector<ResponseBuffer> &responses) {
+      std::vector<json> params;
+      params.reserve(indexes.size());
+      for (size_t i : indexes) {
+        params.push_back(std::move(batch[i]["params"]));
+      }
+      std::vector<BulkResult<json>> results;
+      try {
+        results = dispatcher.InvokeBulk(name, params);
       } catch (...) {
-        return json{{"id", id}, {"error", {{"code", internal_error}, {"message", std::string("internal server error")}}}, {"jsonrpc", "2.0"}};
+        results.assign(indexes.size(), current_bulk_error(name));
+      }
+      for (size_t i = 0; i < indexes.size(); i++) {
+        const json &id = batch[indexes[i]]["id"];
+        if (auto *error = std::get_if<JsonRpcException>(&results[i])) {
+          responses[indexes[i]] = BuildErrorResponse(id, *error);
+        } else {
+          try {
+            responses[indexes[i]] = BuildResultResponse(id, std::get<json>(results[i]).dump());
+          } catch (std::exception &e) {
+            responses[indexes[i]] = BuildErrorResponse(id, JsonRpcException(internal_error, std::string("internal server error: ") + e.what()));
+          }
+        }
       }
     }
 
-    json ProcessSingleRequest(json &request) {
+    void ValidateRequest(json &request) {
       if (!has_key_type(request, "jsonrpc", json::value_t::string) || request["jsonrpc"] != "2.0") {
         throw JsonRpcException(invalid_request, R"(invalid request: missing jsonrpc field set to "2.0")");
       }
@@ -276,19 +901,13 @@ namespace jsonrpccxx {
       if (has_key(request, "params") && !(request["params"].is_array() || request["params"].is_object() || request["params"].is_null())) {
         throw JsonRpcException(invalid_request, "invalid request: params field must be an array, object or null");
       }
+      std::chrono::milliseconds timeout(0);
+      if (has_key(request, "timeout_ms") && !parse_timeout(request["timeout_ms"], timeout)) {
+        throw InvalidTimeout();
+      }
       if (!has_key(request, "params") || has_key_type(request, "params", json::value_t::null)) {
         request["params"] = json::array();
       }
-      if (!has_key(request, "id")) {
-        try {
-          dispatcher.InvokeNotification(request["method"], request["params"]);
-          return json();
-        } catch (std::exception &) {
-          return json();
-        }
-      } else {
-        return {{"jsonrpc", "2.0"}, {"id", request["id"]}, {"result", dispatcher.InvokeMethod(request["method"], request["params"])}};
-      }
     }
   };
 }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace jsonrpccxx {
+  // Collapses concurrent calls with the same key into one execution. The first caller runs the
+  // function, callers arriving while it is still running block and receive its result (or exception).
+  class SingleFlight {
+  public:
+    SingleFlight() : mutex(), calls(), shared(0) {}
+
+    std::string Do(const std::string &key, const std::function<std::string()> &fn) {
+      std::promise<std::string> promise;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto call = calls.find(key);
+        if (call != calls.end()) {
+          std::shared_future<std::string> result = call->second;
+          lock.unlock();
+          shared++;
+          return result.get();
+        }
+        calls.emplace(key, promise.get_future().share());
+      }
+      try {
+        std::string result = fn();
+        finish(key);
+        promise.set_value(result);
+        return result;
+      } catch (...) {
+        finish(key);
+        promise.set_exception(std::current_exception());
+        throw;
+      }
+    }
+
+    // Number of calls that were answered by another caller's execution
+    size_t Shared() const { return shared; }
+    void RecordShared() { shared++; }
+
+  private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_future<std::string>> calls;
+    std::atomic<size_t> shared;
+
+    void finish(const std::string &key) {
+      std::lock_guard<std::mutex> lock(mutex);
+      calls.erase(key);
+    }
+  };
+
+  // Successful results of coalescible calls within one batch request, so that repeated
+  // identical elements of a batch are only executed once.
+  class CallMemo {
+  public:
+    CallMemo() : mutex(), results() {}
+
+    bool Get(const std::string &key, std::string &result) const {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto entry = results.find(key);
+      if (entry == results.end())
+        return false;
+      result = entry->second;
+      return true;
+    }
+
+    void Put(const std::string &key, const std::string &result) {
+      std::lock_guard<std::mutex> lock(mutex);
+      results.emplace(key, result);
+    }
+
+  private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::string> results;
+  };
+} // namespace jsonrpccxx
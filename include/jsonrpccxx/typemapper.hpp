@@ -10,6 +10,7 @@
 #include <sstream>
 #include <tuple>
 #include <utility>
+#include <variant>
 #include <vector>
 
 namespace jsonrpccxx {
@@ -23,6 +24,14 @@ namespace jsonrpccxx {
   // initializer lists while maintaining the order we pass in parameters.
   typedef std::vector<std::pair<std::string, std::string>> ParamArgsMap;
 
+  // Outcome of a single call handled by a bulk handler: either a result or an error
+  template <typename T>
+  using BulkResult = std::variant<T, JsonRpcException>;
+
+  // Receives the (positional) parameters of all calls to the method within one batch and
+  // returns one result or error per call, in the same order.
+  typedef std::function<std::vector<BulkResult<json>>(const std::vector<json> &)> BulkHandle;
+
   // Workaround due to forbidden partial template function specialisation
   template <typename T>
   struct type {};
@@ -183,6 +192,102 @@ namespace jsonrpccxx {
     return GetHandle(methodName, paramNames, std::function<ReturnType(ParamTypes...)>(f));
   }
 
+  //
+  // Bulk mapping
+  //
+  template <typename T>
+  inline BulkResult<json> to_bulk_result(T &&value) {
+    return BulkResult<json>(std::in_place_index<0>, std::forward<T>(value));
+  }
+
+  template <typename T>
+  inline BulkResult<json> to_bulk_result(BulkResult<T> &&result) {
+    if (auto *error = std::get_if<JsonRpcException>(&result)) {
+      return *error;
+    }
+    return BulkResult<json>(std::in_place_index<0>, std::get<0>(std::move(result)));
+  }
+
+  // Maps the exception currently being handled to the error reported for the calls of a bulk handler
+  inline JsonRpcException current_bulk_error(const std::string &methodName) {
+    try {
+      throw;
+    } catch (JsonRpcException &e) {
+      return e;
+    } catch (json::type_error &e) {
+      return JsonRpcException(invalid_params, methodName + ": invalid parameter (" + e.what() + ")");
+    } catch (std::exception &e) {
+      return JsonRpcException(internal_error, "internal server error: " + methodName + ": " + e.what());
+    } catch (...) {
+      return JsonRpcException(internal_error, "internal server error");
+    }
+  }
+
+  // Wraps a handler taking the argument tuples of all calls at once. Calls with invalid parameters are
+  // answered with an error and not passed to the handler. The handler returns either plain results or
+  // BulkResult<T> to fail individual calls.
+  template <typename Result, typename... ParamTypes, std::size_t... index>
+  BulkHandle createBulkHandle(const std::string &methodName, const NamedParamMapping &paramNames,
+                              std::function<std::vector<Result>(const std::vector<std::tuple<ParamTypes...>> &)> method, std::index_sequence<index...> seq,
+                              NamedParamMapping &types) {
+    (void)seq;
+
+    (types.emplace_back(type_name(GetType(type<std::decay_t<ParamTypes>>()))), ...);
+
+    if (paramNames.size() != sizeof...(ParamTypes)) {
+      std::ostringstream errMsgStream;
+      errMsgStream << "Error registering RPC method \"" << methodName << "\": number of parameter names ("
+                   << paramNames.size() << ") does not match registered method's parameter list ("
+                   << sizeof...(ParamTypes) << ").";
+
+      throw std::invalid_argument(errMsgStream.str());
+    }
+
+    BulkHandle handle = [method, methodName, paramNames](const std::vector<json> &calls) -> std::vector<BulkResult<json>> {
+      std::vector<BulkResult<json>> results(calls.size());
+      std::vector<std::tuple<ParamTypes...>> args;
+      std::vector<size_t> positions;
+      args.reserve(calls.size());
+      positions.reserve(calls.size());
+      for (size_t i = 0; i < calls.size(); i++) {
+        const json &params = calls[i];
+        try {
+          size_t actualSize = params.size();
+          size_t formalSize = sizeof...(ParamTypes);
+          if (actualSize != formalSize) {
+            throw JsonRpcException(invalid_params, methodName + ": invalid parameters (expected " + std::to_string(formalSize) + " argument(s), but found " + std::to_string(actualSize) + ")");
+          }
+          (check_param_type<typename std::decay<ParamTypes>::type>(methodName, paramNames[index], params[index], GetType(type<typename std::decay<ParamTypes>::type>())), ...);
+          args.emplace_back(params[index].get<typename std::decay<ParamTypes>::type>()...);
+          positions.push_back(i);
+        } catch (...) {
+          results[i] = current_bulk_error(methodName);
+        }
+      }
+      if (args.empty()) {
+        return results;
+      }
+      std::vector<Result> values;
+      try {
+        values = method(args);
+        if (values.size() != args.size()) {
+          throw std::runtime_error("bulk handler returned " + std::to_string(values.size()) + " results for " + std::to_string(args.size()) + " calls");
+        }
+      } catch (...) {
+        JsonRpcException error = current_bulk_error(methodName);
+        for (size_t position : positions) {
+          results[position] = error;
+        }
+        return results;
+      }
+      for (size_t i = 0; i < values.size(); i++) {
+        results[positions[i]] = to_bulk_result(std::move(values[i]));
+      }
+      return results;
+    };
+    return handle;
+  }
+
   inline MethodHandle GetUncheckedHandle(std::function<json(const json&)> f) {
     MethodHandle handle = [f](const json &params) -> json {
       return f(params);
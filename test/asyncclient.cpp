@@ -0,0 +1,105 @@
+#include "doctest/doctest.h"
+#include "inmemoryconnector.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <jsonrpccxx/asyncclient.hpp>
+#include <jsonrpccxx/server.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace jsonrpccxx;
+
+// Keeps everything the connector sends, answers only when told to
+class ManualAsyncConnector : public IAsyncClientConnector {
+public:
+  ManualAsyncConnector() : requests(), handler() {}
+  vector<json> requests;
+  function<void(const string &)> handler;
+
+  void Send(const string &request) override { requests.push_back(json::parse(request)); }
+  void SetMessageHandler(function<void(const string &)> h) override { handler = std::move(h); }
+  void Respond(const json &response) { handler(response.dump()); }
+};
+
+TEST_CASE("asyncclient_out_of_order") {
+  ManualAsyncConnector c;
+  AsyncJsonRpcClient client(c);
+  auto first = client.CallMethodAsync<int>("add", {1, 2});
+  auto second = client.CallMethodNamedAsync<string>("name", {{"id", 7}});
+  auto third = client.CallMethodAsync<int>("fail");
+  REQUIRE(c.requests.size() == 3);
+  CHECK(c.requests[0]["method"] == "add");
+  CHECK(c.requests[0]["jsonrpc"] == "2.0");
+  CHECK(c.requests[0]["params"] == json({1, 2}));
+  CHECK(c.requests[1]["params"]["id"] == 7);
+  CHECK(c.requests[2]["params"] == json::array());
+  CHECK(c.requests[0]["id"] != c.requests[1]["id"]);
+  CHECK(client.Pending() == 3);
+
+  c.Respond({{"jsonrpc", "2.0"}, {"id", c.requests[1]["id"]}, {"result", "seven"}});
+  c.Respond({{"jsonrpc", "2.0"}, {"id", 4711}, {"result", 1}});
+  c.Respond(json::array({{{"jsonrpc", "2.0"}, {"id", c.requests[2]["id"]}, {"error", {{"code", -32601}, {"message", "method not found: fail"}}}},
+                         {{"jsonrpc", "2.0"}, {"id", c.requests[0]["id"]}, {"result", 3}}}));
+  CHECK(second.get() == "seven");
+  CHECK(first.get() == 3);
+  REQUIRE_THROWS_WITH(third.get(), "method not found: fail");
+  CHECK(client.Pending() == 0);
+
+  auto wrongType = client.CallMethodAsync<int>("add", {1, 2});
+  c.Respond({{"jsonrpc", "2.0"}, {"id", c.requests.back()["id"]}, {"result", "three"}});
+  REQUIRE_THROWS_AS(wrongType.get(), JsonRpcException);
+
+  auto abandoned = client.CallMethodAsync<int>("add", {1, 2});
+  client.FailPending(JsonRpcException(internal_error, "connection lost"));
+  REQUIRE_THROWS_WITH(abandoned.get(), "connection lost");
+
+  client.CallNotification("ping", {});
+  CHECK(!has_key(c.requests.back(), "id"));
+  CHECK(c.requests.back()["method"] == "ping");
+}
+
+TEST_CASE("asyncclient_callback") {
+  ManualAsyncConnector c;
+  AsyncJsonRpcClient client(c);
+  CallResult received;
+  client.CallMethodAsync("add", {1, 2}, [&](CallResult result) { received = std::move(result); });
+  c.Respond({{"jsonrpc", "2.0"}, {"id", c.requests[0]["id"]}, {"result", 3}});
+  REQUIRE(holds_alternative<json>(received));
+  CHECK(get<json>(received) == 3);
+}
+
+TEST_CASE("asyncclient_pipelined") {
+  JsonRpc2Server server;
+  server.SetExecutor(make_shared<ThreadPoolExecutor>(4));
+  REQUIRE(server.Add("square", "", [](int value) {
+    this_thread::sleep_for(chrono::microseconds(value % 7 * 100));
+    return value * value;
+  }, {"value"}));
+  InMemoryAsyncConnector connector(server);
+  AsyncJsonRpcClient client(connector);
+
+  const int threads = 4;
+  const int calls = 250;
+  vector<thread> workers;
+  atomic<int> correct(0);
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      vector<pair<int, future<int>>> outstanding;
+      for (int i = 0; i < calls; i++) {
+        int value = t * calls + i;
+        outstanding.emplace_back(value, client.CallMethodAsync<int>("square", {value}));
+      }
+      for (auto &[value, result] : outstanding) {
+        if (result.get() == value * value)
+          correct++;
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+  CHECK(correct == threads * calls);
+  CHECK(client.Pending() == 0);
+}
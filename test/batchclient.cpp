@@ -1,5 +1,6 @@
 #include "doctest/doctest.h"
 #include "testclientconnector.hpp"
+#include <array>
 #include <iostream>
 #include <jsonrpccxx/batchclient.hpp>
 
@@ -28,6 +29,42 @@ TEST_CASE("batchresponse") {
   CHECK(br.GetResponse()[br.GetInvalidIndexes()[1]] == 3);
 }
 
+TEST_CASE("batchresponse_id_kinds") {
+  json response = json::array();
+  for (int i = 0; i < 1000; i++)
+    response.push_back({{"jsonrpc", "2.0"}, {"id", 999 - i}, {"result", i}});
+  response.push_back({{"jsonrpc", "2.0"}, {"id", 1.5}, {"result", "float"}});
+  response.push_back({{"jsonrpc", "2.0"}, {"id", 18446744073709551615ull}, {"result", "large"}});
+  BatchResponse br(std::move(response));
+
+  CHECK(!br.HasErrors());
+  CHECK(br.Get<int>(0) == 999);
+  CHECK(br.Get<int>(999) == 0);
+  CHECK(br.Get<string>(1.5) == "float");
+  CHECK(br.Get<string>(18446744073709551615ull) == "large");
+  REQUIRE_THROWS_WITH(br.Get<int>("0"), "no result found for id \"0\"");
+  CHECK(br.GetAll<int>({997, 998, 999}) == vector<int>({2, 1, 0}));
+  REQUIRE_THROWS_WITH(br.GetAll<int>({1, 1000}), "no result found for id 1000");
+}
+
+TEST_CASE("batchresponse_numeric_ids") {
+  // Ids that compare equal as JSON numbers match, whatever form the server echoes them in
+  BatchResponse br(json::parse(R"([{"jsonrpc":"2.0","id":1.0,"result":"one"},{"jsonrpc":"2.0","id":2,"result":"two"},
+                                   {"jsonrpc":"2.0","id":3e2,"result":"three hundred"},{"jsonrpc":"2.0","id":-0.0,"result":"zero"},
+                                   {"jsonrpc":"2.0","id":2.5,"result":"two and a half"},{"jsonrpc":"2.0","id":4,"result":[1,2]}])"));
+  CHECK(br.Get<string>(1) == "one");
+  CHECK(br.Get<string>(1.0) == "one");
+  CHECK(br.Get<string>(2.0) == "two");
+  CHECK(br.Get<string>(300) == "three hundred");
+  CHECK(br.Get<string>(0) == "zero");
+  CHECK(br.Get<string>(2.50) == "two and a half");
+  REQUIRE_THROWS_WITH(br.Get<string>("1"), "no result found for id \"1\"");
+  REQUIRE_THROWS_WITH(br.Get<string>(9.223372036854775808e18), "no result found for id 9.223372036854776e+18");
+
+  // Any conversion failure is reported as an invalid return type
+  REQUIRE_THROWS_WITH((br.Get<std::array<int, 3>>(4)), "invalid return type: [json.exception.out_of_range.401] array index 2 is out of range");
+}
+
 TEST_CASE("batchrequest") {
   BatchRequest br;
   TestClientConnector c;
@@ -72,3 +109,31 @@ TEST_CASE("batchclient") {
   c.raw_response = "somestring";
   CHECK_THROWS_WITH(client.BatchCall(r), "invalid JSON response from server: [json.exception.parse_error.101] parse error at line 1, column 1: syntax error while parsing value - invalid literal; last read: 's'");
 }
+
+TEST_CASE("batchbuilder") {
+  BatchBuilder builder(4);
+  CHECK(builder.Buffer() == "[]");
+  builder.AddMethodCall(1, "some_method1", "value1", 42, -7, 1.5, true, nullptr)
+      .AddMethodCall("1", "some_method1", positional_parameter{"value1", {{"a", 1}}})
+      .AddNamedMethodCall(2, "some_method2", {{"param1", "value1"}, {"param2", 3}})
+      .AddNotificationCall("some_notification1", string("quote\" backslash\\ newline\n tab\t bell\x07 ü"))
+      .AddNamedNotificationCall("some_notification2")
+      .AddMethodCall(3, "no_params");
+  CHECK(builder.Size() == 6);
+
+  BatchRequest reference;
+  reference.AddMethodCall(1, "some_method1", {"value1", 42, -7, 1.5, true, nullptr})
+      .AddMethodCall("1", "some_method1", {"value1", {{"a", 1}}})
+      .AddNamedMethodCall(2, "some_method2", {{"param1", "value1"}, {"param2", 3}})
+      .AddNotificationCall("some_notification1", {"quote\" backslash\\ newline\n tab\t bell\x07 ü"})
+      .AddNamedNotificationCall("some_notification2")
+      .AddMethodCall(3, "no_params");
+  CHECK(builder.Buffer() == reference.Build().dump());
+
+  TestClientConnector c;
+  BatchClient client(c);
+  c.SetBatchResult(json::array({TestClientConnector::BuildResult("result1", 1)}));
+  BatchResponse response = client.BatchCall(builder);
+  CHECK(json::parse(builder.Buffer()) == c.request);
+  CHECK(response.Get<string>(1) == "result1");
+}
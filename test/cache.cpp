@@ -0,0 +1,74 @@
+#include "doctest/doctest.h"
+#include <chrono>
+#include <jsonrpccxx/cache.hpp>
+#include <string>
+#include <thread>
+
+using namespace jsonrpccxx;
+using namespace std;
+
+TEST_CASE("cache hit and miss") {
+  ResultCache cache(chrono::milliseconds(10000), 16);
+  string result;
+  CHECK(!cache.Get("[1]", result));
+  cache.Put("[1]", "\"one\"");
+  REQUIRE(cache.Get("[1]", result));
+  CHECK(result == "\"one\"");
+  CHECK(cache.Hits() == 1);
+  CHECK(cache.Misses() == 1);
+  CHECK(cache.Size() == 1);
+
+  cache.Clear();
+  CHECK(!cache.Get("[1]", result));
+  CHECK(cache.Size() == 0);
+}
+
+TEST_CASE("cache expiry") {
+  ResultCache cache(chrono::milliseconds(1), 16);
+  string result;
+  cache.Put("[1]", "1");
+  this_thread::sleep_for(chrono::milliseconds(5));
+  CHECK(!cache.Get("[1]", result));
+  CHECK(cache.Size() == 0);
+}
+
+TEST_CASE("cache capacity") {
+  ResultCache cache(chrono::milliseconds(10000), 4);
+  for (int i = 0; i < 100; i++)
+    cache.Put(to_string(i), to_string(i));
+  CHECK(cache.Size() <= 4);
+
+  ResultCache single(chrono::milliseconds(10000), 1);
+  string result;
+  single.Put("a", "1");
+  single.Put("b", "2");
+  CHECK(single.Size() == 1);
+  CHECK(!single.Get("a", result));
+  CHECK(single.Get("b", result));
+  CHECK(result == "2");
+}
+
+TEST_CASE("cache capacity is split across shards") {
+  ResultCache cache(chrono::milliseconds(10000), 20);
+  for (int i = 0; i < 20; i++)
+    cache.Put(to_string(i), to_string(i));
+  CHECK(cache.Size() == 20);
+
+  ResultCache large(chrono::milliseconds(10000), 1024);
+  for (int i = 0; i < 4096; i++)
+    large.Put(to_string(i), to_string(i));
+  CHECK(large.Size() <= 1024);
+  CHECK(large.Size() > 512);
+}
+
+TEST_CASE("cache drops results computed before a clear") {
+  ResultCache cache(chrono::milliseconds(10000), 16);
+  string result;
+  uint64_t before = cache.Generation();
+  cache.Clear();
+  CHECK(!cache.Put("[1]", "stale", before));
+  CHECK(!cache.Get("[1]", result));
+  CHECK(cache.Put("[1]", "fresh", cache.Generation()));
+  REQUIRE(cache.Get("[1]", result));
+  CHECK(result == "fresh");
+}
@@ -86,6 +86,61 @@ TEST_CASE_FIXTURE(F, "v2_method_call_params_byposition") {
   CHECK(c.request["params"][2] == true);
 }
 
+TEST_CASE_FIXTURE(F, "v2_method_call_timeout") {
+  c.SetResult(true);
+  clientV2.CallMethod<json>("1", "some.method_1", {"hello"}, std::chrono::milliseconds(200));
+  c.VerifyMethodRequest(version::v2, "some.method_1", "1");
+  CHECK(c.request["timeout_ms"] == 200);
+  CHECK(c.request["params"][0] == "hello");
+
+  c.SetResult(true);
+  clientV2.CallMethodNamed<json>("1", "some.method_1", {{"a", 1}}, std::chrono::milliseconds(0));
+  CHECK(c.request["timeout_ms"] == 0);
+
+  c.SetResult(true);
+  clientV2.CallMethod<json>("1", "some.method_1", {"hello"});
+  CHECK(!has_key(c.request, "timeout_ms"));
+}
+
+TEST_CASE_FIXTURE(F, "v2_cancel_call") {
+  clientV2.CancelCall(17);
+  c.VerifyNotificationRequest(version::v2, "rpc.cancel");
+  CHECK(c.request["params"]["id"] == 17);
+  clientV2.CancelCall("abc");
+  CHECK(c.request["params"]["id"] == "abc");
+}
+
+TEST_CASE_FIXTURE(F, "v2_method_call_variadic") {
+  c.SetResult(true);
+  clientV2.CallMethod<json>("1", "some.method_1", "hello", 77, true, nullptr, 1.5, std::string("quote\""));
+  c.VerifyMethodRequest(version::v2, "some.method_1", "1");
+  CHECK(c.request["params"] == json({"hello", 77, true, nullptr, 1.5, "quote\""}));
+
+  c.SetResult(true);
+  clientV2.CallMethod<json>(7, "some.method_1", json::object({{"a", 1}}), 2);
+  c.VerifyMethodRequest(version::v2, "some.method_1", 7);
+  CHECK(c.request["params"] == json::array({{{"a", 1}}, 2}));
+
+  positional_parameter params = {"hello"};
+  c.SetResult(true);
+  clientV2.CallMethod<json>(8, "some.method_1", params);
+  CHECK(c.request["params"] == json({"hello"}));
+  c.SetResult(true);
+  clientV2.CallMethod<json>(9, "some.method_1", params, std::chrono::milliseconds(5));
+  CHECK(c.request["params"] == json({"hello"}));
+  CHECK(c.request["timeout_ms"] == 5);
+
+  c.SetError(JsonRpcException{-32602, "invalid params"});
+  REQUIRE_THROWS_WITH(clientV2.CallMethod<json>(10, "some.method_1", 1, 2), "invalid params");
+}
+
+TEST_CASE_FIXTURE(F, "v1_method_call_variadic") {
+  c.SetResult(23);
+  CHECK(clientV1.CallMethod<int>(37, "some.method_1", "hello", 77) == 23);
+  c.VerifyMethodRequest(version::v1, "some.method_1", 37);
+  CHECK(c.request["params"] == json({"hello", 77}));
+}
+
 TEST_CASE_FIXTURE(F, "v1_method_call_params_byposition") {
   c.SetResult(true);
   clientV1.CallMethod<json>("1", "some.method_1", {"hello", 77, true});
@@ -152,6 +207,40 @@ TEST_CASE_FIXTURE(F, "v2_method_result_empty") {
   c.VerifyMethodRequest(version::v2, "some.method_1", "1");
 }
 
+TEST_CASE_FIXTURE(F, "v2_method_result_typed") {
+  c.raw_response = R"( { "jsonrpc" : "2.0", "result" : -42, "id" : "1" } )";
+  CHECK(clientV2.CallMethod<int>("1", "some.method_1", {}) == -42);
+  c.raw_response = R"({"result":true,"id":1,"jsonrpc":"2.0"})";
+  CHECK(clientV2.CallMethod<bool>("1", "some.method_1", {}) == true);
+  c.raw_response = R"({"jsonrpc":"2.0","id":1,"result":"plain"})";
+  CHECK(clientV2.CallMethod<string>("1", "some.method_1", {}) == "plain");
+  c.raw_response = R"({"jsonrpc":"2.0","id":1,"result":"a \"quoted\" \u00e4"})";
+  CHECK(clientV2.CallMethod<string>("1", "some.method_1", {}) == "a \"quoted\" \xc3\xa4");
+  c.raw_response = R"({"jsonrpc":"2.0","id":1,"result":[1,[2,"]"],{"x":"}"}],"extra":{"id":7}})";
+  CHECK(clientV2.CallMethod<json>("1", "some.method_1", {}) == json::parse(R"([1,[2,"]"],{"x":"}"}])"));
+  c.raw_response = R"({"jsonrpc":"2.0","id":1,"result":2.5})";
+  CHECK(clientV2.CallMethod<double>("1", "some.method_1", {}) == 2.5);
+  c.raw_response = R"({"jsonrpc":"2.0","id":1,"result":"text"})";
+  CHECK_THROWS_AS(clientV2.CallMethod<int>("1", "some.method_1", {}), json::type_error);
+}
+
+TEST_CASE_FIXTURE(F, "v2_method_result_invalid_span") {
+  auto code = [this](const string &response) {
+    c.raw_response = response;
+    try {
+      clientV2.CallMethod<json>("1", "some.method_1", {});
+    } catch (JsonRpcException &e) {
+      return e.Code();
+    }
+    return 0;
+  };
+  CHECK(code(R"({"jsonrpc":"2.0","id":1,"result":12abc})") == parse_error);
+  CHECK(code(R"({"jsonrpc":"2.0","id":1,"result":[1,2})") == parse_error);
+  CHECK(code(R"({"jsonrpc":"2.0","id":1,"result":1} trailing)") == parse_error);
+  CHECK(code(R"({"jsonrpc":"2.0","id":1,"error":"failed"})") == internal_error);
+  CHECK(code(R"({"jsonrpc":"2.0","result":1})") == internal_error);
+}
+
 /*
 TEST_CASE_FIXTURE(F, "v1_method_result_empty") {
   c.raw_response = "{}";
@@ -275,3 +364,22 @@ TEST_CASE_FIXTURE(F, "v1_notification_call_params_byposition") {
 }*/
 
 // TODO: test cases with return type mapping and param mapping for v1/v2 method and notification
+
+TEST_CASE("default SendInto passes the request on without copying it") {
+  struct SendOnly : IClientConnector {
+    SendOnly() : seen(nullptr) {}
+    SendOnly(const SendOnly &) = delete;
+    SendOnly &operator=(const SendOnly &) = delete;
+    string Send(const string &request) override {
+      seen = &request;
+      return "{}";
+    }
+    const string *seen;
+  };
+  SendOnly connector;
+  string request = R"({"jsonrpc":"2.0","id":1,"method":"x"})";
+  string response;
+  connector.SendInto(request, response);
+  CHECK(connector.seen == &request);
+  CHECK(response == "{}");
+}
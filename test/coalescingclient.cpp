@@ -0,0 +1,108 @@
+#include "doctest/doctest.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <jsonrpccxx/coalescingclient.hpp>
+#include <jsonrpccxx/server.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace jsonrpccxx;
+
+// Forwards to a server and remembers the size of every batch
+class CountingConnector : public IClientConnector {
+public:
+  explicit CountingConnector(JsonRpcServer &server) : server(server), mutex(), sizes() {}
+  string Send(const string &request) override {
+    {
+      lock_guard<std::mutex> lock(mutex);
+      sizes.push_back(json::parse(request).size());
+    }
+    return server.HandleRequest(request);
+  }
+  vector<size_t> Sizes() {
+    lock_guard<std::mutex> lock(mutex);
+    return sizes;
+  }
+
+private:
+  JsonRpcServer &server;
+  std::mutex mutex;
+  vector<size_t> sizes;
+};
+
+struct Coalescing {
+  JsonRpc2Server server;
+  CountingConnector connector;
+  atomic<int> notified;
+  Coalescing() : server(), connector(server), notified(0) {
+    server.Add("add", "", [](int a, int b) { return a + b; }, {"a", "b"});
+    server.Add("notify", NotificationHandle([this](const json &params) { notified += params[0].get<int>(); }));
+  }
+};
+
+TEST_CASE_FIXTURE(Coalescing, "coalescing_count_threshold") {
+  {
+    CoalescingClient client(connector, chrono::seconds(10), 4);
+    vector<future<int>> results;
+    for (int i = 0; i < 8; i++)
+      results.push_back(client.CallMethod<int>("add", {i, 1}));
+    for (int i = 0; i < 8; i++)
+      CHECK(results[i].get() == i + 1);
+    CHECK(client.Batches() == 2);
+  }
+  CHECK(connector.Sizes() == vector<size_t>({4, 4}));
+}
+
+TEST_CASE_FIXTURE(Coalescing, "coalescing_window") {
+  CoalescingClient client(connector, chrono::milliseconds(20), 100);
+  auto named = client.CallMethodNamed<int>("add", {{"a", 2}, {"b", 3}});
+  client.CallNotification("notify", {5});
+  auto missing = client.CallMethod<int>("missing", {});
+  auto wrongType = client.CallMethod<string>("add", {1, 1});
+  CHECK(named.get() == 5);
+  REQUIRE_THROWS_WITH(missing.get(), "method not found: missing");
+  REQUIRE_THROWS_AS(wrongType.get(), JsonRpcException);
+  CHECK(notified == 5);
+  CHECK(connector.Sizes() == vector<size_t>({4}));
+
+  auto flushed = client.CallMethod<int>("add", {1, 2});
+  client.Flush();
+  CHECK(flushed.wait_for(chrono::seconds(5)) == future_status::ready);
+  CHECK(flushed.get() == 3);
+}
+
+TEST_CASE_FIXTURE(Coalescing, "coalescing_concurrent_callers") {
+  CoalescingClient client(connector, chrono::milliseconds(2), 64);
+  vector<thread> callers;
+  atomic<int> correct(0);
+  for (int t = 0; t < 8; t++) {
+    callers.emplace_back([&, t]() {
+      for (int i = 0; i < 50; i++) {
+        if (client.CallMethod<int>("add", {t, i}).get() == t + i)
+          correct++;
+      }
+    });
+  }
+  for (auto &c : callers)
+    c.join();
+  CHECK(correct == 400);
+  CHECK(client.Calls() == 400);
+  CHECK(client.Batches() < 400);
+}
+
+// Rejects every value with an exception that is no json::exception
+struct strict_value {};
+static void from_json(const json &, strict_value &) { throw runtime_error("rejected"); }
+
+TEST_CASE_FIXTURE(Coalescing, "coalescing_result_conversion_fails") {
+  CoalescingClient client(connector, chrono::seconds(10), 3);
+  auto first = client.CallMethod<int>("add", {1, 2});
+  auto rejected = client.CallMethod<strict_value>("add", {1, 1});
+  auto last = client.CallMethod<int>("add", {2, 2});
+  CHECK(first.get() == 3);
+  REQUIRE_THROWS_WITH(rejected.get(), "add: invalid return type: rejected");
+  CHECK(last.get() == 4);
+}
@@ -0,0 +1,168 @@
+#include "doctest/doctest.h"
+#include "integrationtest.hpp"
+#include <jsonrpccxx/codec.hpp>
+#include <jsonrpccxx/envelope.hpp>
+#include <jsonrpccxx/serializer.hpp>
+#include <string>
+#include <vector>
+
+using namespace jsonrpccxx;
+using namespace std;
+
+namespace codectest {
+  enum class color { red, green, blue };
+  enum class level { low = 10, high = 20 };
+
+  // Enough entries that names are found by binary search rather than a short scan
+  enum class big { e00, e01, e02, e03, e04, e05, e06, e07, e08, e09, e10, e11, e12, e13, e14, e15, e16, e17, e18, e19, e20, e21, e22, e23, e24, e25, e26, e27, e28, e29, e30, e31, e32, e33, e34, e35, e36, e37, e38, e39 };
+  enum class sparse { k00 = 3, k01 = 10, k02 = 17, k03 = 24, k04 = 31, k05 = 38, k06 = 45, k07 = 52, k08 = 59, k09 = 66, k10 = 73, k11 = 80, k12 = 87, k13 = 94, k14 = 101, k15 = 108, k16 = 115, k17 = 122, k18 = 129, k19 = 136, k20 = 143, k21 = 150, k22 = 157, k23 = 164, k24 = 171, k25 = 178, k26 = 185, k27 = 192, k28 = 199, k29 = 206, k30 = 213, k31 = 220, k32 = 227, k33 = 234, k34 = 241, k35 = 248, k36 = 255, k37 = 262, k38 = 269, k39 = 276 };
+
+  struct item {
+    item() : name(), count(), tint(), tags() {}
+    string name;
+    int count;
+    color tint;
+    vector<string> tags;
+  };
+
+  struct order {
+    order() : id(), items(), prio() {}
+    int64_t id;
+    vector<item> items;
+    level prio;
+  };
+
+  JSONRPCCXX_ENUM(color, {color::red, "red"}, {color::green, "green"}, {color::blue, "blue"})
+  JSONRPCCXX_ENUM(level, {level::low, "low"}, {level::high, "high"})
+  JSONRPCCXX_ENUM(big, {big::e00, "entry_00"}, {big::e01, "entry_01"}, {big::e02, "entry_02"}, {big::e03, "entry_03"}, {big::e04, "entry_04"}, {big::e05, "entry_05"}, {big::e06, "entry_06"}, {big::e07, "entry_07"}, {big::e08, "entry_08"}, {big::e09, "entry_09"}, {big::e10, "entry_10"}, {big::e11, "entry_11"}, {big::e12, "entry_12"}, {big::e13, "entry_13"}, {big::e14, "entry_14"}, {big::e15, "entry_15"}, {big::e16, "entry_16"}, {big::e17, "entry_17"}, {big::e18, "entry_18"}, {big::e19, "entry_19"}, {big::e20, "entry_20"}, {big::e21, "entry_21"}, {big::e22, "entry_22"}, {big::e23, "entry_23"}, {big::e24, "entry_24"}, {big::e25, "entry_25"}, {big::e26, "entry_26"}, {big::e27, "entry_27"}, {big::e28, "entry_28"}, {big::e29, "entry_29"}, {big::e30, "entry_30"}, {big::e31, "entry_31"}, {big::e32, "entry_32"}, {big::e33, "entry_33"}, {big::e34, "entry_34"}, {big::e35, "entry_35"}, {big::e36, "entry_36"}, {big::e37, "entry_37"}, {big::e38, "entry_38"}, {big::e39, "entry_39"})
+  JSONRPCCXX_ENUM(sparse, {sparse::k00, "key0"}, {sparse::k01, "key1"}, {sparse::k02, "key2"}, {sparse::k03, "key3"}, {sparse::k04, "key4"}, {sparse::k05, "key5"}, {sparse::k06, "key6"}, {sparse::k07, "key7"}, {sparse::k08, "key8"}, {sparse::k09, "key9"}, {sparse::k10, "key10"}, {sparse::k11, "key11"}, {sparse::k12, "key12"}, {sparse::k13, "key13"}, {sparse::k14, "key14"}, {sparse::k15, "key15"}, {sparse::k16, "key16"}, {sparse::k17, "key17"}, {sparse::k18, "key18"}, {sparse::k19, "key19"}, {sparse::k20, "key20"}, {sparse::k21, "key21"}, {sparse::k22, "key22"}, {sparse::k23, "key23"}, {sparse::k24, "key24"}, {sparse::k25, "key25"}, {sparse::k26, "key26"}, {sparse::k27, "key27"}, {sparse::k28, "key28"}, {sparse::k29, "key29"}, {sparse::k30, "key30"}, {sparse::k31, "key31"}, {sparse::k32, "key32"}, {sparse::k33, "key33"}, {sparse::k34, "key34"}, {sparse::k35, "key35"}, {sparse::k36, "key36"}, {sparse::k37, "key37"}, {sparse::k38, "key38"}, {sparse::k39, "key39"})
+  JSONRPCCXX_STRUCT(item, JSONRPCCXX_FIELD(name), JSONRPCCXX_FIELD(count), JSONRPCCXX_FIELD_AS(tint, "color"), JSONRPCCXX_FIELD(tags))
+  JSONRPCCXX_STRUCT(order, JSONRPCCXX_FIELD(id), JSONRPCCXX_FIELD(items), JSONRPCCXX_FIELD_AS(prio, "priority"))
+} // namespace codectest
+
+using namespace codectest;
+
+static order make_order() {
+  order o;
+  o.id = 7;
+  o.prio = level::high;
+  item i;
+  i.name = "bolt \"M4\"";
+  i.count = 3;
+  i.tint = color::blue;
+  i.tags = {"a", "b"};
+  o.items = {i, item()};
+  return o;
+}
+
+static void check_order(const order &o) {
+  CHECK(o.id == 7);
+  CHECK(o.prio == level::high);
+  REQUIRE(o.items.size() == 2);
+  CHECK(o.items[0].name == "bolt \"M4\"");
+  CHECK(o.items[0].count == 3);
+  CHECK(o.items[0].tint == color::blue);
+  CHECK(o.items[0].tags == vector<string>{"a", "b"});
+  CHECK(o.items[1].tint == color::red);
+}
+
+TEST_CASE("codec enum tables") {
+  static_assert(has_enum_names<color>::value && !has_enum_names<int>::value);
+  static_assert(enum_names_of<color>().dense && !enum_names_of<level>().dense);
+  CHECK(json(color::green) == "green");
+  CHECK(json(level::high) == "high");
+  CHECK(json("blue").get<color>() == color::blue);
+  CHECK(json("low").get<level>() == level::low);
+  CHECK_THROWS_AS(json("purple").get<color>(), json::type_error);
+  CHECK_THROWS_AS(json(1).get<color>(), json::type_error);
+  CHECK_THROWS_AS(json(static_cast<color>(9)), json::type_error);
+}
+
+TEST_CASE("codec enums with many entries") {
+  static_assert(enum_names_of<big>().dense && !enum_names_of<sparse>().dense);
+  for (int i = 0; i < 40; i++) {
+    string name = (i < 10 ? "entry_0" : "entry_") + to_string(i);
+    CHECK(json(static_cast<big>(i)) == name);
+    CHECK(json(name).get<big>() == static_cast<big>(i));
+    name = "key" + to_string(i);
+    CHECK(json(static_cast<sparse>(i * 7 + 3)) == name);
+    CHECK(json(name).get<sparse>() == static_cast<sparse>(i * 7 + 3));
+    CHECK(decode_json<sparse>("\"" + name + "\"") == static_cast<sparse>(i * 7 + 3));
+  }
+  for (string unknown : {"", "entry_", "entry_40", "key40", "Key1", "entry_00 "}) {
+    CHECK_THROWS_AS(json(unknown).get<big>(), json::type_error);
+    CHECK_THROWS_AS(json(unknown).get<sparse>(), json::type_error);
+  }
+  CHECK_THROWS_AS(json(static_cast<big>(40)), json::type_error);
+  CHECK_THROWS_AS(json(static_cast<sparse>(4)), json::type_error);
+}
+
+TEST_CASE("codec struct round trip") {
+  static_assert(has_fields<order>::value && field_count<order>() == 3 && !has_fields<string>::value);
+  json j = make_order();
+  CHECK(j["priority"] == "high");
+  CHECK(j["items"][0]["color"] == "blue");
+  CHECK(j["items"][0]["tags"] == json::array({"a", "b"}));
+  check_order(j.get<order>());
+
+  string text;
+  append_json(text, make_order());
+  CHECK(json::parse(text) == j);
+  check_order(decode_json<order>(text));
+  check_order(decode_json<order>(" " + j.dump(2) + " "));
+}
+
+TEST_CASE("codec struct errors") {
+  json j = make_order();
+  j["unknown"] = {1, 2};
+  check_order(j.get<order>());
+  check_order(decode_json<order>(j.dump()));
+
+  j.erase("priority");
+  CHECK_THROWS_WITH_AS(j.get<order>(), "[json.exception.type_error.302] missing field \"priority\"", json::type_error);
+  CHECK_THROWS_WITH_AS(decode_json<order>(j.dump()), "[json.exception.type_error.302] missing field \"priority\"", json::type_error);
+  CHECK_THROWS_AS(json::array().get<order>(), json::type_error);
+  CHECK_THROWS_AS(decode_json<order>("[]"), json::type_error);
+  CHECK_THROWS_AS(decode_json<order>(R"({"id":1,"items":[],"priority":"none"})"), json::type_error);
+  CHECK_THROWS_AS(decode_json<order>(R"({"id":1,"items":[})"), json::parse_error);
+
+  // Escaped keys and strings take the DOM path
+  order o = decode_json<order>(R"({"id":5,"items":[{"name":"\u00e4","count":1,"c\u006flor":"red","tags":[]}],"priority":"low"})");
+  CHECK(o.id == 5);
+  CHECK(o.items[0].name == "\xc3\xa4");
+  CHECK(o.items[0].tint == color::red);
+}
+
+TEST_CASE_FIXTURE(IntegrationTest, "codec types as parameters and results") {
+  rpcServer.Add("first", "", [](const order &o) { return o.items.at(0); }, {"order"});
+  rpcServer.Add("tint", "", [](color c, const item &i) { return i.tint == c; }, {"color", "item"});
+
+  item i = client.CallMethod<item>(1, "first", {make_order()});
+  CHECK(i.name == "bolt \"M4\"");
+  CHECK(i.tint == color::blue);
+  CHECK(client.CallMethod<item>(1, "first", make_order()).count == 3);
+  CHECK(client.CallMethod<bool>(1, "tint", color::blue, make_order().items[0]));
+  CHECK_THROWS_AS(client.CallMethod<bool>(1, "tint", "purple", item()), JsonRpcException);
+
+  json broken = make_order();
+  broken.erase("items");
+  try {
+    client.CallMethod<item>(1, "first", {broken});
+    FAIL("expected invalid_params");
+  } catch (JsonRpcException &e) {
+    CHECK(e.Code() == invalid_params);
+    CHECK(e.Message().find("missing field \"items\"") != string::npos);
+  }
+}
+
+TEST_CASE("codec numbers") {
+  CHECK(decode_json<int>("-42") == -42);
+  CHECK(decode_json<uint64_t>("18446744073709551615") == 18446744073709551615ull);
+  CHECK(decode_json<double>("1.5") == 1.5);
+  CHECK(decode_json<double>("-2.5e3") == -2500.0);
+  CHECK(decode_json<float>("0.25") == 0.25f);
+  // Read by the json parser whether or not floating-point from_chars is available
+  CHECK(decode_json<double>(" 3 ") == 3.0);
+  CHECK(decode_json<int>("7.0") == 7);
+  CHECK_THROWS_AS(decode_json<double>("1.5x"), json::parse_error);
+}
@@ -449,3 +449,28 @@ TEST_CASE("check filtering methods by metadata") {
   const auto bad_both_keys_methods = d.FilterMethodsByMetadata({{key1, value}, {key2, bad_value}});
   CHECK(bad_both_keys_methods.empty());
 }
+
+TEST_CASE("add and invoke raw bulk handle") {
+  Dispatcher d;
+  BulkHandle handle = [](const std::vector<json> &calls) {
+    std::vector<BulkResult<json>> results;
+    for (const auto &params : calls)
+      results.emplace_back(std::in_place_index<0>, params[0].get<int>() + 1);
+    return results;
+  };
+  CHECK(d.AddBulk("inc", "", handle, {"x"}));
+  CHECK(!d.AddBulk("inc", "", handle, {"x"}));
+  CHECK(d.ContainsBulk("inc"));
+  CHECK(d.ContainsMethod("inc"));
+
+  auto results = d.InvokeBulk("inc", {json{1}, json{{"x", 2}}, json{{"y", 3}}});
+  REQUIRE(results.size() == 3);
+  CHECK(std::get<json>(results[0]) == 2);
+  CHECK(std::get<json>(results[1]) == 3);
+  CHECK(std::string(std::get<JsonRpcException>(results[2]).what()) == "inc: missing named parameter \"x\"");
+  CHECK(d.InvokeMethod("inc", {41}) == 42);
+  REQUIRE_THROWS_WITH(d.InvokeBulk("unknown", {}), "method not found: unknown");
+
+  CHECK(d.Remove("inc"));
+  CHECK(!d.ContainsBulk("inc"));
+}
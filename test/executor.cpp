@@ -0,0 +1,115 @@
+#include "doctest/doctest.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+#include <jsonrpccxx/executor.hpp>
+#include <thread>
+
+using namespace jsonrpccxx;
+using namespace std;
+
+TEST_CASE("inline executor") {
+  InlineExecutor executor;
+  auto caller = this_thread::get_id();
+  thread::id executed;
+  executor.Execute([&]() { executed = this_thread::get_id(); });
+  CHECK((executed == caller));
+}
+
+TEST_CASE("thread pool executor runs all tasks") {
+  atomic<int> count(0);
+  {
+    ThreadPoolExecutor executor(4);
+    for (int i = 0; i < 1000; i++)
+      executor.Execute([&]() { count++; });
+  }
+  CHECK(count == 1000);
+}
+
+TEST_CASE("work stealing executor runs all tasks") {
+  atomic<int> count(0);
+  {
+    WorkStealingExecutor executor(4);
+    for (int i = 0; i < 100; i++) {
+      executor.Execute([&]() {
+        // Submitted from a worker, ends up in its local queue
+        for (int j = 0; j < 10; j++)
+          executor.Execute([&]() { count++; });
+        count++;
+      });
+    }
+    while (count < 1100)
+      this_thread::yield();
+  }
+  CHECK(count == 1100);
+}
+
+TEST_CASE("strand drain on an executor is bounded") {
+  // Runs tasks only when the test says so
+  struct ManualExecutor : IExecutor {
+    ManualExecutor() : jobs() {}
+    void Execute(std::function<void()> task) override { jobs.push_back(std::move(task)); }
+    void RunNext() {
+      auto job = std::move(jobs.front());
+      jobs.erase(jobs.begin());
+      job();
+    }
+    vector<std::function<void()>> jobs;
+  };
+  ManualExecutor executor;
+  auto strand = make_shared<Strand>();
+  vector<int> order;
+  strand->Post(&executor, [&]() {
+    order.push_back(1);
+    strand->Post(&executor, [&]() {
+      order.push_back(2);
+      // Queued after the turn started, left for the next one
+      strand->Post(&executor, [&]() { order.push_back(4); });
+    });
+    strand->Post(&executor, [&]() { order.push_back(3); });
+  });
+  REQUIRE(executor.jobs.size() == 1);
+  executor.RunNext();
+  CHECK(order == vector<int>{1, 2, 3});
+  REQUIRE(executor.jobs.size() == 1);
+  executor.RunNext();
+  CHECK(order == vector<int>{1, 2, 3, 4});
+  CHECK(executor.jobs.empty());
+  CHECK(strand->Executed() == 4);
+}
+
+TEST_CASE("strand hands an inline drain over to the next poster") {
+  auto strand = make_shared<Strand>();
+  promise<void> started[3], release[3];
+  thread::id ran[4];
+  auto task = [&](int i) {
+    return [&, i]() {
+      ran[i] = this_thread::get_id();
+      if (i < 3) {
+        started[i].set_value();
+        release[i].get_future().wait();
+      }
+    };
+  };
+  thread first([&]() { strand->Post(nullptr, task(0)); });
+  started[0].get_future().wait();
+  thread([&]() { strand->Post(nullptr, task(1)); }).join();
+  release[0].set_value();
+  started[1].get_future().wait();
+  thread([&]() { strand->Post(nullptr, task(2)); }).join();
+  release[1].set_value();
+  // The first thread is past its share now, the next poster takes over once task 2 finished
+  started[2].get_future().wait();
+  thread last([&]() { strand->Post(nullptr, task(3)); });
+  this_thread::sleep_for(chrono::milliseconds(20));
+  release[2].set_value();
+  first.join();
+  auto lastId = last.get_id();
+  last.join();
+  CHECK((ran[1] == ran[0]));
+  CHECK((ran[2] == ran[0]));
+  CHECK((ran[3] == lastId));
+  CHECK(strand->Executed() == 4);
+}
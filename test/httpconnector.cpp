@@ -0,0 +1,110 @@
+#include "doctest/doctest.h"
+#include "cpphttplibconnector.hpp"
+#include <atomic>
+#include <chrono>
+#include <jsonrpccxx/client.hpp>
+#include <jsonrpccxx/server.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace jsonrpccxx;
+
+TEST_CASE("http connector") {
+  JsonRpc2Server server;
+  server.Add("add", "", [](int a, int b) { return a + b; }, {"a", "b"});
+
+  // Not an address of this host
+  CppHttpLibServerConnector blocked(server, 0, "203.0.113.1");
+  CHECK(!blocked.StartListening());
+
+  // Stopping waits for idle persistent connections to time out
+  CppHttpLibServerConnector connector(server, 0, "127.0.0.1", 4, 1000, chrono::seconds(1));
+  REQUIRE(connector.StartListening());
+  CHECK(!connector.StartListening());
+  REQUIRE(connector.Port() > 0);
+
+  CppHttpLibClientConnector single("127.0.0.1", connector.Port(), true);
+  JsonRpcClient singleClient(single, version::v2);
+  CHECK(singleClient.CallMethod<int>(1, "add", 1, 2) == 3);
+
+  // 8 threads share 3 persistent connections
+  CppHttpLibPooledClientConnector pool("127.0.0.1", connector.Port(), 3);
+  JsonRpcClient client(pool, version::v2);
+  vector<thread> threads;
+  atomic<int> failures(0);
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&client, &failures, t]() {
+      for (int i = 0; i < 50; i++)
+        failures += client.CallMethod<int>(i, "add", t, i) != t + i;
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  CHECK(failures == 0);
+  CHECK(pool.Connections() <= 3);
+  CHECK(pool.Opened() == pool.Connections());
+
+  int port = connector.Port();
+  connector.StopListening();
+  CHECK_THROWS_AS(client.CallMethod<int>(1, "add", 1, 2), JsonRpcException);
+  CHECK(pool.Connections() < 3);
+
+  // Restarting on the same port, the pool reconnects
+  CppHttpLibServerConnector restarted(server, port, "127.0.0.1", 4, 1000, chrono::seconds(1));
+  REQUIRE(restarted.StartListening());
+  CHECK(client.CallMethod<int>(1, "add", 2, 2) == 4);
+}
+
+TEST_CASE("http compression") {
+  JsonRpc2Server server;
+  server.Add("echo", "", [](const string &s) { return s; }, {"s"});
+  CppHttpLibServerConnector connector(server, 0, "127.0.0.1", 4, 100, chrono::seconds(1));
+  REQUIRE(connector.StartListening());
+
+  string large(100000, 'x');
+  CppHttpLibClientConnector plain("127.0.0.1", connector.Port());
+  CppHttpLibPooledClientConnector compressing("127.0.0.1", connector.Port(), 1);
+  compressing.SetCompression(64);
+  for (IClientConnector *c : {static_cast<IClientConnector *>(&plain), static_cast<IClientConnector *>(&compressing)}) {
+    JsonRpcClient client(*c, version::v2);
+    CHECK(client.CallMethod<string>(1, "echo", large) == large);
+    CHECK(client.CallMethod<string>(2, "echo", "small") == "small");
+  }
+
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+  CHECK(http::Negotiate("gzip, deflate") == http::Encoding::gzip);
+  CHECK(http::Negotiate("deflate, gzip;q=0.5") == http::Encoding::deflate);
+  CHECK(http::Negotiate("gzip;q=0, deflate;q=0") == http::Encoding::identity);
+  CHECK(http::Negotiate("br") == http::Encoding::identity);
+  CHECK(http::Negotiate("") == http::Encoding::identity);
+
+  // Raw responses: only large ones are compressed, with the negotiated encoding
+  httplib::Client raw("127.0.0.1", connector.Port());
+  raw.set_decompress(false);
+  string request = json{{"jsonrpc", "2.0"}, {"id", 1}, {"method", "echo"}, {"params", {large}}}.dump();
+  for (const char *encoding : {"gzip", "deflate"}) {
+    auto res = raw.Post("/jsonrpc", httplib::Headers{{"Accept-Encoding", encoding}}, request, "application/json");
+    REQUIRE(res);
+    CHECK(res->get_header_value("Content-Encoding") == encoding);
+    CHECK(res->get_header_value("Vary") == "Accept-Encoding");
+    CHECK(res->body.size() < 1000);
+  }
+  // Sent uncompressed to this client, but not to others: caches have to tell them apart
+  auto identity = raw.Post("/jsonrpc", httplib::Headers{{"Accept-Encoding", "identity"}}, request, "application/json");
+  REQUIRE(identity);
+  CHECK(!identity->has_header("Content-Encoding"));
+  CHECK(identity->get_header_value("Vary") == "Accept-Encoding");
+  auto small = raw.Post("/jsonrpc", httplib::Headers{{"Accept-Encoding", "gzip"}}, R"({"jsonrpc":"2.0","id":1,"method":"echo","params":["small"]})", "application/json");
+  REQUIRE(small);
+  CHECK(!small->has_header("Content-Encoding"));
+  CHECK(!small->has_header("Vary"));
+
+  connector.SetCompression(0);
+  auto disabled = raw.Post("/jsonrpc", httplib::Headers{{"Accept-Encoding", "gzip"}}, request, "application/json");
+  REQUIRE(disabled);
+  CHECK(!disabled->has_header("Content-Encoding"));
+  CHECK(json::parse(disabled->body)["result"] == large);
+#endif
+}
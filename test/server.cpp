@@ -1,7 +1,16 @@
 #include "doctest/doctest.h"
+#include "inmemoryconnector.hpp"
 #include "testserverconnector.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <jsonrpccxx/client.hpp>
+#include <jsonrpccxx/iclientconnector.hpp>
 #include <jsonrpccxx/server.hpp>
 
 using namespace jsonrpccxx;
@@ -60,16 +69,16 @@ TEST_CASE_FIXTURE(Server2, "v2_malformed_requests") {
   connector.VerifyMethodError(-32600, "invalid request: params field must be an array, object or null", 1);
 }
 
-enum class category { ord, cc };
+enum class product_category { ord, cc };
 
-NLOHMANN_JSON_SERIALIZE_ENUM(category, {{category::ord, "order"}, {category::cc, "cc"}})
+NLOHMANN_JSON_SERIALIZE_ENUM(product_category, {{product_category::ord, "order"}, {product_category::cc, "cc"}})
 
 struct product {
   product() : id(), price(), name(), cat() {}
   int id;
   double price;
   string name;
-  category cat;
+  product_category cat;
 };
 
 void to_json(json &j, const product &p);
@@ -142,11 +151,11 @@ TEST_CASE_FIXTURE(Server2, "v2_invocations") {
   CHECK(t.catalog[0].id == 1);
   CHECK(t.catalog[0].name == "some product");
   CHECK(t.catalog[0].price == 23.3);
-  CHECK(t.catalog[0].cat == category::cc);
+  CHECK(t.catalog[0].cat == product_category::cc);
   CHECK(t.catalog[1].id == 2);
   CHECK(t.catalog[1].name == "some product 2");
   CHECK(t.catalog[1].price == 23.4);
-  CHECK(t.catalog[1].cat == category::ord);
+  CHECK(t.catalog[1].cat == product_category::ord);
 
   connector.CallNotification("dirty_notification", nullptr);
   connector.VerifyNotificationResult();
@@ -558,3 +567,697 @@ TEST_CASE("check filtering methods by metadata") {
   const auto bad_both_keys_methods = server.FilterMethodsByMetadata({{key1, value}, {key2, bad_value}});
   CHECK(bad_both_keys_methods.empty());
 }
+
+TEST_CASE_FIXTURE(Server2, "v2_result_cache") {
+  int calls = 0;
+  REQUIRE(server.Add("lookup", "", [&calls](int key) { calls++; return json{{"key", key}, {"call", calls}}; }, {"key"}));
+  REQUIRE(server.AddMethodMetadata("lookup", {{"cacheable", true}, {"ttl_ms", 10000}, {"max_entries", 8}}));
+
+  connector.CallMethod(1, "lookup", {3});
+  CHECK(connector.VerifyMethodResult(1) == json{{"key", 3}, {"call", 1}});
+  connector.CallMethod("abc", "lookup", {3});
+  CHECK(connector.VerifyMethodResult("abc") == json{{"key", 3}, {"call", 1}});
+  connector.CallMethod(2, "lookup", {{"key", 3}});
+  CHECK(connector.VerifyMethodResult(2) == json{{"key", 3}, {"call", 1}});
+  CHECK(calls == 1);
+
+  connector.CallMethod(3, "lookup", {4});
+  CHECK(connector.VerifyMethodResult(3) == json{{"key", 4}, {"call", 2}});
+
+  connector.CallMethod(4, "lookup", {"invalid"});
+  connector.VerifyMethodError(-32602, "invalid parameter", 4);
+  connector.CallMethod(4, "lookup", {"invalid"});
+  connector.VerifyMethodError(-32602, "invalid parameter", 4);
+
+  json stats = server.Statistics()["cache"]["lookup"];
+  CHECK(stats["hits"] == 2);
+  CHECK(stats["misses"] == 4);
+  CHECK(stats["entries"] == 2);
+
+  REQUIRE(server.InvalidateCache("lookup"));
+  CHECK(!server.InvalidateCache("unknown"));
+  connector.CallMethod(5, "lookup", {3});
+  CHECK(connector.VerifyMethodResult(5) == json{{"key", 3}, {"call", 3}});
+
+  for (const json &invalid : {json{{"cacheable", "yes"}}, json{{"ttl_ms", 0}}, json{{"ttl_ms", -1}}, json{{"ttl_ms", "1000"}}, json{{"max_entries", 0}},
+                              json{{"max_entries", -1}}, json{{"max_entries", 1.5}}, json{{"coalescible", 1}}, json{{"executor", 1}},
+                              json{{"strand", nullptr}}, json{{"cancellable", "true"}}}) {
+    CAPTURE(invalid);
+    CHECK(!server.AddMethodMetadata("lookup", invalid));
+  }
+  connector.CallMethod(6, "lookup", {3});
+  CHECK(connector.VerifyMethodResult(6) == json{{"key", 3}, {"call", 3}});
+
+  REQUIRE(server.Remove("lookup"));
+  CHECK(server.Statistics()["cache"].empty());
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_result_cache_invalidated_while_running") {
+  std::atomic<int> calls(0);
+  std::promise<void> started, release;
+  std::shared_future<void> released = release.get_future().share();
+  REQUIRE(server.Add("lookup", "", [&](int key) {
+    if (calls++ == 0) {
+      started.set_value();
+      released.wait();
+    }
+    return key + calls;
+  }, {"key"}));
+  REQUIRE(server.AddMethodMetadata("lookup", {{"cacheable", true}}));
+
+  std::thread stale([&]() { server.HandleRequest(TestServerConnector::BuildMethodCall(1, "lookup", {1}).dump()); });
+  started.get_future().wait();
+  REQUIRE(server.InvalidateCache("lookup"));
+  release.set_value();
+  stale.join();
+
+  // The result computed before the invalidation was not stored
+  connector.CallMethod(2, "lookup", {1});
+  CHECK(connector.VerifyMethodResult(2) == 3);
+  CHECK(calls == 2);
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_coalescing") {
+  std::atomic<int> calls(0);
+  REQUIRE(server.Add("slow", "", [&](int key) {
+    calls++;
+    // Hold the first execution until all other callers joined it
+    for (int i = 0; i < 500 && server.Statistics()["coalesced"]["slow"].get<int>() < 7; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return key * 2;
+  }, {"key"}));
+  REQUIRE(server.AddMethodMetadata("slow", {{"coalescible", true}}));
+
+  std::vector<std::thread> threads;
+  std::vector<json> results(8);
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&, t]() { results[t] = json::parse(server.HandleRequest(TestServerConnector::BuildMethodCall(t, "slow", {21}).dump())); });
+  }
+  for (auto &t : threads)
+    t.join();
+  CHECK(calls == 1);
+  for (int t = 0; t < 8; t++) {
+    CHECK(TestServerConnector::VerifyMethodResult(t, results[t]) == 42);
+  }
+
+  json batchcall;
+  batchcall.push_back(connector.BuildMethodCall(1, "slow", {5}));
+  batchcall.push_back(connector.BuildMethodCall(2, "slow", {{"key", 5}}));
+  batchcall.push_back(connector.BuildMethodCall(3, "slow", {6}));
+  batchcall.push_back(connector.BuildMethodCall(4, "slow", {5}));
+  connector.SendRequest(batchcall);
+  json batchresponse = connector.VerifyBatchResponse();
+  REQUIRE(batchresponse.size() == 4);
+  CHECK(calls == 3);
+  CHECK(TestServerConnector::VerifyMethodResult(1, batchresponse[0]) == 10);
+  CHECK(TestServerConnector::VerifyMethodResult(2, batchresponse[1]) == 10);
+  CHECK(TestServerConnector::VerifyMethodResult(3, batchresponse[2]) == 12);
+  CHECK(TestServerConnector::VerifyMethodResult(4, batchresponse[3]) == 10);
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_bulk") {
+  TestServer t;
+  REQUIRE(server.Add("add_function", GetHandle("add_function", {"a", "b"}, &TestServer::add_function, t), {"a", "b"}));
+
+  std::vector<size_t> invocations;
+  REQUIRE(server.AddBulk("get", "Bulk lookup", [&](const std::vector<std::tuple<int>> &keys) {
+    invocations.push_back(keys.size());
+    std::vector<BulkResult<int>> results;
+    for (const auto &[key] : keys) {
+      if (key < 0)
+        results.emplace_back(JsonRpcException(-32001, "negative key"));
+      else
+        results.emplace_back(key * 10);
+    }
+    return results;
+  }, {"key"}));
+  REQUIRE(server.AddBulk("fail", "", [](const std::vector<std::tuple<int>> &) -> std::vector<int> { throw JsonRpcException(-32002, "backend down"); }, {"key"}));
+  REQUIRE(!server.AddBulk("get", "", [](const std::vector<std::tuple<int>> &keys) { return std::vector<int>(keys.size()); }, {"key"}));
+  CHECK(server.ContainsMethod("get"));
+  CHECK(server.MethodParamTypes("get") == std::vector<std::string>{"integer"});
+
+  json batchcall;
+  batchcall.push_back(connector.BuildMethodCall(1, "get", {1}));
+  batchcall.push_back(connector.BuildMethodCall(2, "add_function", {{"a", 3}, {"b", 4}}));
+  batchcall.push_back(connector.BuildMethodCall("3", "get", {{"key", 2}}));
+  batchcall.push_back(connector.BuildMethodCall(4, "get", {"x"}));
+  batchcall.push_back(connector.BuildMethodCall(5, "get", {-1}));
+  batchcall.push_back(connector.BuildNotificationCall("get", {6}));
+  batchcall.push_back(connector.BuildMethodCall(7, "fail", {1}));
+  batchcall.push_back(connector.BuildMethodCall(8, "fail", {2}));
+  connector.SendRequest(batchcall);
+  json batchresponse = connector.VerifyBatchResponse();
+  REQUIRE(batchresponse.size() == 7);
+  CHECK(invocations == std::vector<size_t>{3});
+  CHECK(TestServerConnector::VerifyMethodResult(1, batchresponse[0]) == 10);
+  CHECK(TestServerConnector::VerifyMethodResult(2, batchresponse[1]) == 7);
+  CHECK(TestServerConnector::VerifyMethodResult("3", batchresponse[2]) == 20);
+  TestServerConnector::VerifyMethodError(-32602, R"(invalid parameter "key")", 4, batchresponse[3]);
+  TestServerConnector::VerifyMethodError(-32001, "negative key", 5, batchresponse[4]);
+  TestServerConnector::VerifyMethodError(-32002, "backend down", 7, batchresponse[5]);
+  TestServerConnector::VerifyMethodError(-32002, "backend down", 8, batchresponse[6]);
+
+  connector.CallMethod(9, "get", {4});
+  CHECK(connector.VerifyMethodResult(9) == 40);
+  connector.CallMethod(10, "get", {-4});
+  connector.VerifyMethodError(-32001, "negative key", 10);
+  CHECK(invocations == std::vector<size_t>{3, 1, 1});
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_executors") {
+  auto pool = std::make_shared<ThreadPoolExecutor>(2);
+  REQUIRE(server.AddExecutor("pool", pool));
+  REQUIRE(!server.AddExecutor("pool", pool));
+
+  const auto caller = std::this_thread::get_id();
+  std::atomic<int> arrived(0);
+  auto rendezvous = [&](int value) {
+    // Only returns if both calls of the batch run at the same time
+    arrived++;
+    for (int i = 0; i < 500 && arrived < 2; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return arrived == 2 && std::this_thread::get_id() != caller ? value : -1;
+  };
+  REQUIRE(server.Add("heavy", "", rendezvous, {"value"}));
+  REQUIRE(server.Add("cheap", "", [&]() { return std::this_thread::get_id() == caller; }));
+  REQUIRE(server.AddMethodMetadata("heavy", {{"executor", "pool"}}));
+
+  json batchcall;
+  batchcall.push_back(connector.BuildMethodCall(1, "heavy", {1}));
+  batchcall.push_back(connector.BuildMethodCall(2, "cheap", nullptr));
+  batchcall.push_back(connector.BuildMethodCall(3, "heavy", {3}));
+  connector.SendRequest(batchcall);
+  json batchresponse = connector.VerifyBatchResponse();
+  REQUIRE(batchresponse.size() == 3);
+  CHECK(TestServerConnector::VerifyMethodResult(1, batchresponse[0]) == 1);
+  CHECK(TestServerConnector::VerifyMethodResult(2, batchresponse[1]) == true);
+  CHECK(TestServerConnector::VerifyMethodResult(3, batchresponse[2]) == 3);
+
+  server.SetExecutor(pool);
+  connector.CallMethod(4, "cheap", nullptr);
+  CHECK(connector.VerifyMethodResult(4) == false);
+
+  std::promise<std::string> response;
+  server.HandleRequestAsync(TestServerConnector::BuildMethodCall(5, "cheap", nullptr).dump(), [&](std::string r) { response.set_value(r); });
+  json result = json::parse(response.get_future().get());
+  CHECK(TestServerConnector::VerifyMethodResult(5, result) == false);
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_strands") {
+  server.SetExecutor(std::make_shared<ThreadPoolExecutor>(4));
+  std::atomic<int> inside(0);
+  std::atomic<int> maxInside(0);
+  std::vector<int> order;
+  auto serial = [&](int value) {
+    int now = ++inside;
+    maxInside = std::max(maxInside.load(), now);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    order.push_back(value);
+    inside--;
+    return value;
+  };
+  REQUIRE(server.Add("first", "", serial, {"value"}));
+  REQUIRE(server.Add("second", "", serial, {"value"}));
+  REQUIRE(server.AddMethodMetadata("first", {{"strand", "store"}}));
+  REQUIRE(server.AddMethodMetadata("second", {{"strand", "store"}}));
+
+  json batchcall;
+  for (int i = 0; i < 20; i++)
+    batchcall.push_back(connector.BuildMethodCall(i, i % 2 ? "first" : "second", {i}));
+  connector.SendRequest(batchcall);
+  json batchresponse = connector.VerifyBatchResponse();
+  REQUIRE(batchresponse.size() == 20);
+  for (int i = 0; i < 20; i++)
+    CHECK(TestServerConnector::VerifyMethodResult(i, batchresponse[i]) == i);
+  CHECK(maxInside == 1);
+  CHECK(order.size() == 20);
+
+  json stats = server.Statistics()["strands"]["store"];
+  CHECK(stats["executed"] == 20);
+  CHECK(stats["contended"].get<int>() > 0);
+  CHECK(stats["max_queue"].get<int>() > 0);
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_admission_control") {
+  server.SetExecutor(std::make_shared<ThreadPoolExecutor>(2));
+  std::mutex gate;
+  std::atomic<int> calls(0);
+  REQUIRE(server.Add("slow", "", [&](int value) {
+    calls++;
+    std::lock_guard<std::mutex> lock(gate);
+    return value;
+  }, {"value"}));
+  REQUIRE(server.Add("fast", "", [](int value) { return value; }, {"value"}));
+  REQUIRE(server.AddMethodMetadata("slow", {{"max_in_flight", 1}}));
+  auto callAsync = [&](int id) {
+    auto response = std::make_shared<std::promise<std::string>>();
+    server.HandleRequestAsync(TestServerConnector::BuildMethodCall(id, "slow", {id}).dump(), [response](std::string r) { response->set_value(r); });
+    return response->get_future();
+  };
+
+  SUBCASE("per method") {
+    gate.lock();
+    auto first = callAsync(1);
+    connector.CallMethod(2, "slow", {2});
+    json error = connector.VerifyMethodError(server_overloaded, "server overloaded: too many calls of this method in flight", 2);
+    CHECK(JsonRpcException::fromJson(error).Type() == server_error);
+    connector.CallMethod(3, "fast", {3});
+    CHECK(connector.VerifyMethodResult(3) == 3);
+    gate.unlock();
+    json response = json::parse(first.get());
+    CHECK(TestServerConnector::VerifyMethodResult(1, response) == 1);
+    connector.CallMethod(4, "slow", {4});
+    CHECK(connector.VerifyMethodResult(4) == 4);
+    CHECK(calls == 2);
+
+    json stats = server.Statistics()["admission"]["methods"]["slow"];
+    CHECK(stats["rejected"] == 1);
+    CHECK(stats["in_flight"] == 0);
+  }
+
+  SUBCASE("global") {
+    server.SetMaxInFlight(1);
+    gate.lock();
+    auto first = callAsync(1);
+    connector.CallMethod(2, "fast", {2});
+    connector.VerifyMethodError(server_overloaded, "server overloaded: too many calls in flight", 2);
+    connector.CallNotification("fast", {3});
+    connector.VerifyNotificationResult();
+    gate.unlock();
+    json response = json::parse(first.get());
+    CHECK(TestServerConnector::VerifyMethodResult(1, response) == 1);
+    connector.CallMethod(4, "fast", {4});
+    CHECK(connector.VerifyMethodResult(4) == 4);
+
+    json stats = server.Statistics()["admission"];
+    CHECK(stats["rejected"] == 2);
+    CHECK(stats["in_flight"] == 0);
+  }
+
+  SUBCASE("metadata") {
+    // 0 means no bound, like SetMaxInFlight(0)
+    REQUIRE(server.AddMethodMetadata("slow", {{"max_in_flight", 0}}));
+    CHECK(!server.Statistics()["admission"]["methods"].contains("slow"));
+    gate.lock();
+    auto first = callAsync(1);
+    auto second = callAsync(2);
+    gate.unlock();
+    json response = json::parse(first.get());
+    CHECK(TestServerConnector::VerifyMethodResult(1, response) == 1);
+    response = json::parse(second.get());
+    CHECK(TestServerConnector::VerifyMethodResult(2, response) == 2);
+
+    for (json invalid : {json(-1), json(1.5), json("2"), json(nullptr), json::array()}) {
+      CHECK(!server.AddMethodMetadata("slow", {{"max_in_flight", invalid}}));
+    }
+    CHECK(server.MethodMetadata("slow")["max_in_flight"] == 0);
+  }
+
+  SUBCASE("replaced while in flight") {
+    server.SetMaxInFlight(1);
+    gate.lock();
+    auto first = callAsync(1);
+    while (calls == 0)
+      std::this_thread::yield();
+    // The running call keeps the limits it was admitted under, the new ones start empty
+    server.SetMaxInFlight(2);
+    REQUIRE(server.AddMethodMetadata("slow", {{"max_in_flight", 2}}));
+    auto second = callAsync(2);
+    CHECK(server.Statistics()["admission"]["in_flight"] == 1);
+    CHECK(server.Statistics()["admission"]["methods"]["slow"]["in_flight"] == 1);
+    server.SetMaxInFlight(0);
+    gate.unlock();
+    json response = json::parse(first.get());
+    CHECK(TestServerConnector::VerifyMethodResult(1, response) == 1);
+    response = json::parse(second.get());
+    CHECK(TestServerConnector::VerifyMethodResult(2, response) == 2);
+    CHECK(server.Statistics()["admission"]["methods"]["slow"]["in_flight"] == 0);
+  }
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_queue_delay_shedding") {
+  server.SetExecutor(std::make_shared<ThreadPoolExecutor>(1));
+  server.SetQueueDelayTarget(std::chrono::milliseconds(1), std::chrono::milliseconds(5));
+  std::atomic<int> calls(0);
+  REQUIRE(server.Add("work", "", [&](int value) {
+    calls++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    return value;
+  }, {"value"}));
+
+  const int count = 40;
+  std::vector<std::promise<std::string>> responses(count);
+  for (int i = 0; i < count; i++)
+    server.HandleRequestAsync(TestServerConnector::BuildMethodCall(i, "work", {i}).dump(), [&, i](std::string response) { responses[i].set_value(response); });
+
+  int shed = 0;
+  for (int i = 0; i < count; i++) {
+    json response = json::parse(responses[i].get_future().get());
+    if (has_key(response, "error")) {
+      TestServerConnector::VerifyMethodError(server_overloaded, "server overloaded: call queued for too long", i, response);
+      shed++;
+    } else {
+      CHECK(TestServerConnector::VerifyMethodResult(i, response) == i);
+    }
+  }
+  CHECK(shed > 0);
+  CHECK(calls == count - shed);
+  CHECK(server.Statistics()["admission"]["shed"] == shed);
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_queue_delay_target_replaced") {
+  server.SetExecutor(std::make_shared<ThreadPoolExecutor>(1));
+  server.SetQueueDelayTarget(std::chrono::milliseconds(1), std::chrono::milliseconds(5));
+  REQUIRE(server.Add("work", "", [](int value) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return value;
+  }, {"value"}));
+
+  // Queued calls keep using the shedder they were admitted under while it is replaced and removed
+  const int count = 40;
+  std::vector<std::promise<std::string>> responses(count);
+  for (int i = 0; i < count; i++) {
+    server.HandleRequestAsync(TestServerConnector::BuildMethodCall(i, "work", {i}).dump(), [&, i](std::string response) { responses[i].set_value(response); });
+    if (i % 10 == 9)
+      server.SetQueueDelayTarget(std::chrono::milliseconds(i % 20 == 9 ? 2 : 0));
+  }
+  for (int i = 0; i < count; i++) {
+    json response = json::parse(responses[i].get_future().get());
+    CHECK((has_key(response, "error") || TestServerConnector::VerifyMethodResult(i, response) == i));
+  }
+  CHECK(!has_key(server.Statistics()["admission"], "shed"));
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_deadlines") {
+  std::chrono::steady_clock::duration remaining = std::chrono::steady_clock::duration::zero();
+  bool hasDeadline = true;
+  REQUIRE(server.Add("budget", "", [&]() {
+    hasDeadline = RequestContext::Current()->HasDeadline();
+    remaining = RequestContext::Current()->Remaining();
+    return true;
+  }));
+  CHECK(RequestContext::Current() == nullptr);
+
+  connector.CallMethod(1, "budget", nullptr);
+  connector.VerifyMethodResult(1);
+  CHECK(!hasDeadline);
+  CHECK(remaining == std::chrono::steady_clock::duration::max());
+
+  json request = TestServerConnector::BuildMethodCall(2, "budget", nullptr);
+  request["timeout_ms"] = 5000;
+  connector.SendRequest(request);
+  connector.VerifyMethodResult(2);
+  CHECK(hasDeadline);
+  CHECK(remaining > std::chrono::seconds(4));
+  CHECK(remaining <= std::chrono::seconds(5));
+
+  REQUIRE(server.AddMethodMetadata("budget", {{"timeout_ms", 1000}}));
+  connector.CallMethod(3, "budget", nullptr);
+  connector.VerifyMethodResult(3);
+  CHECK(remaining > std::chrono::milliseconds(500));
+  CHECK(remaining <= std::chrono::seconds(1));
+
+  // timeout_ms has to be a non-negative integer and is cut to max_timeout_ms
+  request = TestServerConnector::BuildMethodCall(4, "budget", nullptr);
+  request["timeout_ms"] = std::numeric_limits<uint64_t>::max();
+  connector.SendRequest(request);
+  connector.VerifyMethodResult(4);
+  CHECK(remaining > std::chrono::hours(23));
+  CHECK(remaining <= std::chrono::milliseconds(max_timeout_ms));
+  for (json invalid : {json(-1), json(1.5), json(1e30), json("100"), json(nullptr)}) {
+    request["timeout_ms"] = invalid;
+    connector.SendRequest(request);
+    connector.VerifyMethodError(invalid_params, "timeout_ms must be a non-negative integer", 4);
+    json batch = json::array({request, TestServerConnector::BuildMethodCall(5, "budget", nullptr)});
+    json responses = json::parse(server.HandleRequest(batch.dump()));
+    REQUIRE(responses.size() == 2);
+    TestServerConnector::VerifyMethodError(invalid_params, "timeout_ms must be a non-negative integer", 4, responses[0]);
+    TestServerConnector::VerifyMethodResult(5, responses[1]);
+    CHECK(server.HandleJson(request)["error"]["code"] == invalid_params);
+  }
+
+  // 0 means no deadline, in a request as in metadata
+  request["timeout_ms"] = 0;
+  connector.SendRequest(request);
+  connector.VerifyMethodResult(4);
+  CHECK(!hasDeadline);
+  REQUIRE(server.AddMethodMetadata("budget", {{"timeout_ms", 0}}));
+  connector.CallMethod(5, "budget", nullptr);
+  connector.VerifyMethodResult(5);
+  CHECK(!hasDeadline);
+  REQUIRE(server.AddMethodMetadata("budget", {{"timeout_ms", 1000}}));
+  for (json invalid : {json(-1), json(2.5), json("1000")}) {
+    CHECK(!server.AddMethodMetadata("budget", {{"timeout_ms", invalid}}));
+  }
+  CHECK(server.MethodMetadata("budget")["timeout_ms"] == 1000);
+
+  SUBCASE("expired while queued") {
+    auto pool = std::make_shared<ThreadPoolExecutor>(1);
+    server.SetExecutor(pool);
+    std::mutex gate;
+    std::atomic<int> calls(0);
+    REQUIRE(server.Add("blocker", "", [&]() {
+      std::lock_guard<std::mutex> lock(gate);
+      return true;
+    }));
+    REQUIRE(server.Add("count", "", [&]() { return ++calls; }));
+
+    gate.lock();
+    std::promise<std::string> blocked;
+    server.HandleRequestAsync(TestServerConnector::BuildMethodCall(4, "blocker", nullptr).dump(), [&](std::string r) { blocked.set_value(r); });
+    json batch = json::array();
+    for (int i = 0; i < 3; i++) {
+      batch.push_back(TestServerConnector::BuildMethodCall(10 + i, "count", nullptr));
+    }
+    batch[0]["timeout_ms"] = 1;
+    batch[1]["timeout_ms"] = 60000;
+    batch.push_back(TestServerConnector::BuildNotificationCall("count", nullptr));
+    batch[3]["timeout_ms"] = 1;
+    std::promise<std::string> batched;
+    server.HandleRequestAsync(batch.dump(), [&](std::string r) { batched.set_value(r); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    gate.unlock();
+
+    blocked.get_future().get();
+    json responses = json::parse(batched.get_future().get());
+    REQUIRE(responses.size() == 3);
+    TestServerConnector::VerifyMethodError(deadline_exceeded, "deadline exceeded", 10, responses[0]);
+    CHECK(TestServerConnector::VerifyMethodResult(11, responses[1]) == 1);
+    CHECK(TestServerConnector::VerifyMethodResult(12, responses[2]) == 2);
+    CHECK(calls == 2);
+    CHECK(server.Statistics()["deadlines"]["expired"] == 2);
+  }
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_cancellation") {
+  server.SetExecutor(std::make_shared<ThreadPoolExecutor>(2));
+  std::mutex gate;
+  std::atomic<int> started(0);
+  std::atomic<int> observed(0);
+  REQUIRE(server.Add("long", "", [&](int value) {
+    started++;
+    if (RequestContext::Current()->Token()->WaitFor(std::chrono::seconds(10)))
+      observed++;
+    std::lock_guard<std::mutex> lock(gate);
+    return value;
+  }, {"value"}));
+  REQUIRE(server.AddMethodMetadata("long", {{"cancellable", true}, {"max_in_flight", 1}}));
+  auto callAsync = [&](int id) {
+    auto response = std::make_shared<std::promise<std::string>>();
+    server.HandleRequestAsync(TestServerConnector::BuildMethodCall(id, "long", {id}).dump(), [response](std::string r) { response->set_value(r); });
+    return response->get_future();
+  };
+
+  gate.lock();
+  auto first = callAsync(1);
+  while (started == 0)
+    std::this_thread::yield();
+  connector.CallNotification("rpc.cancel", {1});
+  connector.VerifyNotificationResult();
+  json response = json::parse(first.get());
+  TestServerConnector::VerifyMethodError(request_cancelled, "request cancelled", 1, response);
+  while (observed == 0)
+    std::this_thread::yield();
+
+  // The slot was released although the first handler is still running
+  auto second = callAsync(2);
+  connector.CallMethod(3, "rpc.cancel", {{"id", 2}});
+  CHECK(connector.VerifyMethodResult(3) == true);
+  response = json::parse(second.get());
+  TestServerConnector::VerifyMethodError(request_cancelled, "request cancelled", 2, response);
+
+  connector.CallMethod(4, "rpc.cancel", {42});
+  CHECK(connector.VerifyMethodResult(4) == false);
+  connector.CallMethod(5, "rpc.cancel", json::array());
+  connector.VerifyMethodError(invalid_params, "rpc.cancel expects the id", 5);
+  gate.unlock();
+
+  auto third = callAsync(6);
+  response = json::parse(third.get());
+  CHECK(TestServerConnector::VerifyMethodResult(6, response) == 6);
+  CHECK(server.Statistics()["cancelled"] == 2);
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_cancellation_scopes") {
+  server.SetExecutor(std::make_shared<ThreadPoolExecutor>(2));
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::atomic<int> started(0);
+  REQUIRE(server.Add("long", "", [&](int value) {
+    started++;
+    released.wait();
+    return value;
+  }, {"value"}));
+  REQUIRE(server.AddMethodMetadata("long", {{"cancellable", true}}));
+  RequestScope alice = NewRequestScope();
+  RequestScope bob = NewRequestScope();
+  CHECK(alice != bob);
+  auto callAsync = [&](RequestScope scope, int value) {
+    auto response = std::make_shared<std::promise<std::string>>();
+    server.HandleRequestAsync(TestServerConnector::BuildMethodCall(1, "long", {value}).dump(), [response](std::string r) { response->set_value(r); }, scope);
+    return response->get_future();
+  };
+  auto cancel = [&](RequestScope scope) {
+    std::promise<std::string> response;
+    server.HandleRequestAsync(TestServerConnector::BuildMethodCall(2, "rpc.cancel", {1}).dump(), [&response](std::string r) { response.set_value(r); }, scope);
+    json result = json::parse(response.get_future().get());
+    return TestServerConnector::VerifyMethodResult(2, result);
+  };
+
+  // Both clients use id 1, only the call made in the canceller's scope is cancelled
+  auto first = callAsync(alice, 10);
+  auto second = callAsync(bob, 20);
+  while (started < 2)
+    std::this_thread::yield();
+  CHECK(cancel(0) == false);
+  CHECK(cancel(alice) == true);
+  json response = json::parse(first.get());
+  TestServerConnector::VerifyMethodError(request_cancelled, "request cancelled", 1, response);
+  CHECK(second.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout);
+  release.set_value();
+  response = json::parse(second.get());
+  CHECK(TestServerConnector::VerifyMethodResult(1, response) == 20);
+  CHECK(cancel(bob) == false);
+  CHECK(server.Statistics()["cancelled"] == 1);
+}
+
+TEST_CASE("response buffer") {
+  ResponseBuffer buffer("{\"a\":");
+  ResponseBuffer value;
+  value.Append("1");
+  value.Append("");
+  buffer.Append(std::move(value));
+  buffer.AppendStatic("}");
+  CHECK(value.Empty());
+  CHECK(buffer.Segments().size() == 3);
+  CHECK(buffer.Size() == 7);
+  ResponseBuffer moved = std::move(buffer);
+  CHECK(moved.ToString() == R"({"a":1})");
+  string out = "x";
+  moved.AppendTo(out);
+  CHECK(out == R"(x{"a":1})");
+  CHECK(std::move(moved).ToString() == R"({"a":1})");
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_buffers") {
+  server.Add("echo", "", [](const string &s) { return s; }, {"s"});
+  server.Add("notify", NotificationHandle([](const json &) {}));
+
+  // The result is its own segment between the envelope prefix and suffix
+  ResponseBuffer single = server.HandleBuffer(R"({"jsonrpc":"2.0","id":1,"method":"echo","params":["abc"]})");
+  REQUIRE(single.Segments().size() == 3);
+  CHECK(single.Segments()[1] == R"("abc")");
+  CHECK(single.ToString() == R"({"id":1,"jsonrpc":"2.0","result":"abc"})");
+  CHECK(server.HandleBuffer(R"({"jsonrpc":"2.0","method":"notify"})").Empty());
+
+  for (string request : {R"({"jsonrpc":"2.0","id":1,"method":"echo","params":["abc"]})", R"({"jsonrpc":"2.0","id":2,"method":"missing"})", "{invalid", "[]", "3",
+                         R"([{"jsonrpc":"2.0","id":1,"method":"echo","params":["a"]},{"jsonrpc":"2.0","method":"notify"},{"jsonrpc":"2.0","id":2,"method":"x"}])",
+                         R"([{"jsonrpc":"2.0","method":"notify"}])"}) {
+    string expected = server.HandleRequest(request);
+    CHECK(server.HandleBuffer(request).ToString() == expected);
+    string async;
+    server.HandleBufferAsync(request, [&async](ResponseBuffer response) { async = std::move(response).ToString(); });
+    CHECK(async == expected);
+  }
+
+  struct StringOnly : IClientConnector {
+    explicit StringOnly(JsonRpcServer &server) : server(server) {}
+    string Send(const string &request) override { return server.HandleRequest(request); }
+    JsonRpcServer &server;
+  } connector(server);
+  string response = "stale";
+  connector.SendInto(R"({"jsonrpc":"2.0","id":1,"method":"echo","params":["abc"]})", response);
+  CHECK(response == R"({"id":1,"jsonrpc":"2.0","result":"abc"})");
+}
+
+TEST_CASE_FIXTURE(Server2, "v2_direct") {
+  std::atomic<int> notified(0);
+  server.Add("add", "", [](int a, int b) { return a + b; }, {"a", "b"});
+  server.Add("fail", "", []() -> int { throw JsonRpcException(-32010, "failed", {{"reason", "test"}}); });
+  server.Add("crash", "", []() -> int { throw std::runtime_error("crashed"); });
+  server.Add("cached", "", [](int a) { return json{{"a", a}}; }, {"a"});
+  server.Add("binary", "", []() { return json{{"ok", "abc"}, {"bytes", {std::string("\xff\xfe")}}}; });
+  server.Add("binary key", "", []() { return json{{std::string("\xc0\xaf"), 1}}; });
+  server.Add("notify", NotificationHandle([&notified](const json &) { notified++; }));
+  REQUIRE(server.AddMethodMetadata("cached", {{"cacheable", true}}));
+
+  // Same responses as on the wire, including validation errors, rejections and the serialized path
+  for (json request : {json::parse(R"({"jsonrpc":"2.0","id":1,"method":"add","params":[1,2]})"), json::parse(R"({"jsonrpc":"2.0","id":"x","method":"add","params":{"a":1,"b":2}})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":2,"method":"add","params":["a",2]})"), json::parse(R"({"jsonrpc":"2.0","id":3,"method":"add"})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":4,"method":"missing"})"), json::parse(R"({"jsonrpc":"2.0","id":5,"method":"fail"})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":6,"method":"crash"})"), json::parse(R"({"id":7,"method":"add","params":[1,2]})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":[8],"method":"add","params":[1,2]})"), json::parse(R"({"jsonrpc":"2.0","id":9,"method":"add","params":3})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":10,"method":"add","params":[1,2],"timeout_ms":0})"), json::parse(R"({"jsonrpc":"2.0","id":11,"method":"cached","params":[1]})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":12,"method":"cached","params":[1]})"), json::parse(R"({"jsonrpc":"2.0","id":13,"method":"rpc.cancel","params":[1]})"),
+                       json::parse(R"([{"jsonrpc":"2.0","id":14,"method":"add","params":[1,2]},{"jsonrpc":"2.0","method":"notify"}])"), json(3), json::array(),
+                       json::parse(R"({"jsonrpc":"2.0","id":15,"method":"binary"})"), json::parse(R"({"jsonrpc":"2.0","id":16,"method":"binary key"})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":17,"method":"add","params":[1,2],"timeout_ms":-1})"),
+                       json::parse(R"({"jsonrpc":"2.0","id":18,"method":"add","params":[1,2],"timeout_ms":"10"})")}) {
+    string wire = server.HandleRequest(request.dump());
+    CHECK(server.HandleJson(request) == json::parse(wire));
+  }
+  // A result that cannot be serialized fails on the direct path too
+  CHECK(server.HandleJson({{"jsonrpc", "2.0"}, {"id", 15}, {"method", "binary"}})["error"]["code"] == internal_error);
+  CHECK(server.HandleJson({{"jsonrpc", "2.0"}, {"method", "notify"}}).is_null());
+  CHECK(server.HandleJson({{"jsonrpc", "2.0"}, {"method", "missing"}}).is_null());
+  CHECK(notified == 3);
+
+  server.SetMaxInFlight(1);
+  std::mutex gate;
+  REQUIRE(server.Add("slow", "", [&gate]() {
+    std::lock_guard<std::mutex> lock(gate);
+    return 1;
+  }));
+  server.SetExecutor(std::make_shared<ThreadPoolExecutor>(1));
+  gate.lock();
+  json first;
+  std::promise<void> answered;
+  server.HandleJsonAsync({{"jsonrpc", "2.0"}, {"id", 1}, {"method", "slow"}}, [&](json response) {
+    first = std::move(response);
+    answered.set_value();
+  });
+  json rejected = server.HandleJson({{"jsonrpc", "2.0"}, {"id", 2}, {"method", "add"}, {"params", {1, 2}}});
+  CHECK(rejected["error"]["code"] == server_overloaded);
+  gate.unlock();
+  answered.get_future().wait();
+  CHECK(first["result"] == 1);
+
+  // The client takes the direct path whenever its connector offers it
+  server.SetMaxInFlight(0);
+  InMemoryDirectConnector direct(server);
+  JsonRpcClient client(direct, version::v2);
+  CHECK(client.CallMethod<int>(1, "add", 3, 4) == 7);
+  CHECK(client.CallMethod<int>(1, "add", {3, 4}) == 7);
+  CHECK(client.CallMethodNamed<int>("x", "add", {{"a", 3}, {"b", 4}}) == 7);
+  CHECK(client.CallMethod<json>(1, "cached", {2}) == json{{"a", 2}});
+  REQUIRE_THROWS_WITH(client.CallMethod<int>(1, "missing"), "method not found: missing");
+  try {
+    client.CallMethod<int>(1, "fail");
+    FAIL("expected an exception");
+  } catch (JsonRpcException &e) {
+    CHECK(e.Code() == -32010);
+    CHECK(e.Data() == json{{"reason", "test"}});
+  }
+  client.CallNotification("notify");
+  CHECK(notified == 4);
+}
@@ -0,0 +1,472 @@
+#include "doctest/doctest.h"
+#include "epollconnector.hpp"
+#include "shardedserver.hpp"
+#include "shmconnector.hpp"
+#include "uringconnector.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <set>
+#include <jsonrpccxx/asyncclient.hpp>
+#include <jsonrpccxx/batchclient.hpp>
+#include <jsonrpccxx/client.hpp>
+#include <jsonrpccxx/peer.hpp>
+#include <jsonrpccxx/server.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace jsonrpccxx;
+
+static vector<string> Decode(FrameDecoder &decoder, const string &bytes, size_t chunk) {
+  vector<string> frames;
+  for (size_t pos = 0; pos < bytes.size(); pos += chunk) {
+    size_t size = min(chunk, bytes.size() - pos);
+    memcpy(decoder.Reserve(size), bytes.data() + pos, size);
+    decoder.Commit(size);
+    string_view frame;
+    while (decoder.Next(frame))
+      frames.emplace_back(frame);
+  }
+  return frames;
+}
+
+TEST_CASE("framing round trip") {
+  for (Framing framing : {Framing::newline, Framing::length_prefixed}) {
+    string stream;
+    AppendFrame(stream, R"({"a":1})", framing);
+    AppendFrame(stream, "", framing);
+    AppendFrame(stream, string(100000, 'x'), framing);
+    for (size_t chunk : {size_t(1), size_t(7), size_t(1 << 20)}) {
+      FrameDecoder decoder(framing);
+      auto frames = Decode(decoder, stream, chunk);
+      REQUIRE(frames.size() == 3);
+      CHECK(frames[0] == R"({"a":1})");
+      CHECK(frames[1].empty());
+      CHECK(frames[2] == string(100000, 'x'));
+      CHECK(!decoder.Partial());
+      CHECK(!decoder.Failed());
+    }
+  }
+
+  FrameDecoder crlf(Framing::newline);
+  CHECK(Decode(crlf, "1\r\n2\n", 1) == vector<string>{"1", "2"});
+
+  // Brackets and quotes inside strings do not count, a line ending inside a value ends the stream
+  FrameDecoder strings(Framing::newline);
+  CHECK(Decode(strings, "{\"s\":\"}\\\"{[\"}\n[]\n", 3) == vector<string>{R"({"s":"}\"{["})", "[]"});
+  CHECK(!strings.Failed());
+  for (string multiline : {"{\"a\":\n1}\n{}\n", "[1,\n2]\n[]\n", "{\"a\":\"x\n\"}\n{}\n"}) {
+    FrameDecoder decoder(Framing::newline);
+    auto frames = Decode(decoder, multiline, 2);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0] == multiline.substr(0, multiline.find('\n')));
+    CHECK(decoder.Failed());
+    CHECK(decoder.Truncated());
+  }
+
+  FrameDecoder small(Framing::length_prefixed, 16);
+  string tooLarge;
+  AppendFrame(tooLarge, string(17, 'x'), Framing::length_prefixed);
+  CHECK(Decode(small, tooLarge, 64).empty());
+  CHECK(small.Failed());
+}
+
+TEST_CASE("epoll connector") {
+  JsonRpc2Server server;
+  atomic<int> notified(0);
+  server.Add("add", "", [](int a, int b) { return a + b; }, {"a", "b"});
+  server.Add("echo", "", [](const string &s) { return s; }, {"s"});
+  server.Add("notify", NotificationHandle([&notified](const json &) { notified++; }));
+
+  for (Framing framing : {Framing::newline, Framing::length_prefixed}) {
+    EpollServerConnector connector(server, 0, framing, 2);
+    REQUIRE(connector.StartListening());
+    CHECK(!connector.StartListening());
+    REQUIRE(connector.Port() > 0);
+
+    TcpClientConnector c("localhost", connector.Port(), framing);
+    JsonRpcClient client(c, version::v2);
+    CHECK(client.CallMethod<int>(1, "add", 3, 4) == 7);
+    CHECK(client.CallMethod<string>(2, "echo", string(200000, 'y') + "\n") == string(200000, 'y') + "\n");
+    client.CallNotification("notify", {});
+    REQUIRE_THROWS_WITH(client.CallMethod<int>(3, "missing", 1), "method not found: missing");
+
+    BatchClient batch(c);
+    BatchRequest request;
+    request.AddMethodCall(1, "add", {1, 1}).AddNotificationCall("notify", {}).AddMethodCall(2, "add", {2, 2});
+    BatchResponse response = batch.BatchCall(request);
+    CHECK(response.Get<int>(1) == 2);
+    CHECK(response.Get<int>(2) == 4);
+    CHECK(notified == (framing == Framing::newline ? 2 : 4));
+
+    vector<thread> clients;
+    atomic<int> failures(0);
+    for (int t = 0; t < 4; t++) {
+      clients.emplace_back([&connector, &failures, framing, t]() {
+        TcpClientConnector own("127.0.0.1", connector.Port(), framing);
+        JsonRpcClient ownClient(own, version::v2);
+        for (int i = 0; i < 200; i++)
+          failures += ownClient.CallMethod<int>(i, "add", t, i) != t + i;
+      });
+    }
+    for (auto &t : clients)
+      t.join();
+    CHECK(failures == 0);
+  }
+}
+
+TEST_CASE("epoll connector pipelining") {
+  JsonRpc2Server server;
+  server.SetExecutor(make_shared<ThreadPoolExecutor>(4));
+  promise<void> release;
+  shared_future<void> released = release.get_future().share();
+  server.Add("slow", "", [released]() {
+    released.wait();
+    return string("slow");
+  });
+  server.Add("square", "", [](int x) { return x * x; }, {"x"});
+
+  EpollServerConnector connector(server, 0, Framing::length_prefixed);
+  REQUIRE(connector.StartListening());
+  TcpAsyncClientConnector c("127.0.0.1", connector.Port(), Framing::length_prefixed);
+  AsyncJsonRpcClient client(c);
+
+  // Later requests on the same connection are answered while the first one still runs
+  auto slow = client.CallMethodAsync<string>("slow");
+  vector<future<int>> squares;
+  for (int i = 0; i < 100; i++)
+    squares.push_back(client.CallMethodAsync<int>("square", {i}));
+  for (int i = 0; i < 100; i++)
+    CHECK(squares[static_cast<size_t>(i)].get() == i * i);
+  CHECK(slow.wait_for(chrono::milliseconds(0)) == future_status::timeout);
+  release.set_value();
+  CHECK(slow.get() == "slow");
+}
+
+TEST_CASE("epoll connector stops reading clients that do not read") {
+  JsonRpc2Server server;
+  atomic<int> calls(0);
+  server.Add("blob", "", [&calls](int size) { return calls++, string(static_cast<size_t>(size), 'z'); }, {"size"});
+  EpollServerConnector connector(server, 0, Framing::newline);
+  REQUIRE(connector.StartListening());
+
+  // Far more response bytes than the output limit and socket buffers hold together
+  const int count = 300;
+  string requests;
+  for (int i = 0; i < count; i++)
+    requests += R"({"jsonrpc":"2.0","id":)" + to_string(i) + R"(,"method":"blob","params":[262144]})" + "\n";
+  int fd = tcp::Connect("127.0.0.1", connector.Port());
+  REQUIRE(fd >= 0);
+  REQUIRE(tcp::WriteAll(fd, requests));
+  int seen = -1;
+  while (seen != calls) {
+    seen = calls;
+    this_thread::sleep_for(chrono::milliseconds(50));
+  }
+  CHECK(calls < count / 2);
+
+  // Reading the responses lets the server go on with the buffered requests
+  FrameDecoder decoder(Framing::newline);
+  int responses = 0;
+  string_view frame;
+  while (responses < count) {
+    ssize_t n = recv(fd, decoder.Reserve(1 << 20), 1 << 20, 0);
+    REQUIRE(n > 0);
+    decoder.Commit(static_cast<size_t>(n));
+    while (decoder.Next(frame))
+      responses++;
+  }
+  close(fd);
+  CHECK(calls == count);
+}
+
+TEST_CASE("epoll connector errors") {
+  JsonRpc2Server server;
+  EpollServerConnector blocked(server, 0, Framing::newline, 1, "not an address");
+  CHECK(!blocked.StartListening());
+
+  EpollServerConnector connector(server, 0, Framing::newline);
+  REQUIRE(connector.StartListening());
+  int port = connector.Port();
+  TcpClientConnector c("127.0.0.1", port, Framing::newline);
+  CHECK(json::parse(c.Send("{invalid")).at("error").at("code") == parse_error);
+  connector.StopListening();
+  CHECK_THROWS_AS(c.Send("{}"), JsonRpcException);
+  CHECK_THROWS_AS(TcpClientConnector("127.0.0.1", port), JsonRpcException);
+}
+
+TEST_CASE("sharded tcp server") {
+  vector<size_t> configured;
+  ShardedTcpServer sharded(
+      [&configured](JsonRpc2Server &server, size_t shard) {
+        configured.push_back(shard);
+        server.Add("shard", "", [shard]() { return shard; });
+      },
+      0, Framing::length_prefixed, 2);
+  CHECK(configured == vector<size_t>{0, 1});
+  CHECK(sharded.Shards() == 2);
+  REQUIRE(sharded.StartListening());
+  CHECK(!sharded.StartListening());
+  REQUIRE(sharded.Port() > 0);
+
+  // SO_REUSEPORT spreads connections by their address hash, so only the set of shards is checked
+  set<size_t> seen;
+  for (int i = 0; i < 32; i++) {
+    TcpClientConnector c("127.0.0.1", sharded.Port(), Framing::length_prefixed);
+    JsonRpcClient client(c, version::v2);
+    size_t shard = client.CallMethod<size_t>(1, "shard");
+    CHECK(shard < 2);
+    seen.insert(shard);
+  }
+  CHECK(!seen.empty());
+  CHECK(sharded.Statistics().size() == 2);
+
+  sharded.StopListening();
+  CHECK_THROWS_AS(TcpClientConnector("127.0.0.1", sharded.Port()), JsonRpcException);
+  CHECK(sharded.StartListening());
+}
+
+TEST_CASE("shared memory connector") {
+  JsonRpc2Server server;
+  server.Add("echo", "", [](const string &s) { return s; }, {"s"});
+  server.Add("notify", NotificationHandle([](const json &) {}));
+
+  string name = "/jsonrpccxx-test-" + to_string(getpid());
+  ShmServerConnector connector(server, name, 4096);
+  REQUIRE(connector.StartListening());
+  CHECK(!connector.StartListening());
+  ShmServerConnector duplicate(server, name);
+  CHECK(!duplicate.StartListening());
+
+  for (auto busyPoll : {chrono::microseconds(0), chrono::microseconds(50)}) {
+    ShmClientConnector c(name, busyPoll);
+    // The rings have room for one producer and one consumer each
+    CHECK_THROWS_AS(ShmClientConnector{name}, JsonRpcException);
+    JsonRpcClient client(c, version::v2);
+    // Messages of varying size wrap around the 4k rings many times
+    for (size_t i = 0; i < 300; i++)
+      CHECK(client.CallMethod<string>(1, "echo", string(i * 5, 'z')) == string(i * 5, 'z'));
+    client.CallNotification("notify", {});
+    CHECK(client.CallMethod<string>(1, "echo", "after notification") == "after notification");
+    CHECK_THROWS_AS(client.CallMethod<string>(1, "echo", string(4096, 'z')), JsonRpcException);
+  }
+
+  ShmClientConnector c(name);
+  connector.StopListening();
+  CHECK_THROWS_AS(c.Send("{}"), JsonRpcException);
+  CHECK_THROWS_AS(ShmClientConnector{name}, JsonRpcException);
+}
+
+TEST_CASE("shared memory connector waits for the channel to be initialized") {
+  // Sized but not initialized yet, as seen by a client racing the creator
+  string name = "/jsonrpccxx-test-init-" + to_string(getpid());
+  const size_t capacity = 4096;
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  REQUIRE(fd >= 0);
+  size_t size = sizeof(shm::Layout) + 2 * capacity;
+  REQUIRE(ftruncate(fd, static_cast<off_t>(size)) == 0);
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  REQUIRE(memory != MAP_FAILED);
+  thread creator([memory, capacity]() {
+    this_thread::sleep_for(chrono::milliseconds(20));
+    auto *layout = new (memory) shm::Layout{{0}, capacity, {0}, {0}, {}, {}};
+    layout->tag.store(shm::Layout::magic, memory_order_release);
+  });
+  {
+    ShmClientConnector c(name);
+  }
+  creator.join();
+  munmap(memory, size);
+  close(fd);
+  shm_unlink(name.c_str());
+}
+
+TEST_CASE("io_uring connector") {
+  JsonRpc2Server server;
+  server.SetExecutor(make_shared<ThreadPoolExecutor>(2));
+  server.Add("add", "", [](int a, int b) { return a + b; }, {"a", "b"});
+  server.Add("echo", "", [](const string &s) { return s; }, {"s"});
+  server.Add("notify", NotificationHandle([](const json &) {}));
+
+  for (bool useUring : {true, false}) {
+    UringServerConnector connector(server, 0, Framing::length_prefixed, 2, "127.0.0.1", useUring);
+    CHECK(connector.Engine() == (useUring && uring::Supported() ? "io_uring" : "epoll"));
+    REQUIRE(connector.StartListening());
+    CHECK(!connector.StartListening());
+    REQUIRE(connector.Port() > 0);
+
+    TcpClientConnector c("127.0.0.1", connector.Port(), Framing::length_prefixed);
+    JsonRpcClient client(c, version::v2);
+    CHECK(client.CallMethod<int>(1, "add", 3, 4) == 7);
+    // Spans many receive buffers
+    CHECK(client.CallMethod<string>(2, "echo", string(300000, 'y')) == string(300000, 'y'));
+    client.CallNotification("notify", {});
+    CHECK(json::parse(c.Send("{invalid")).at("error").at("code") == parse_error);
+
+    TcpAsyncClientConnector pipelined("127.0.0.1", connector.Port(), Framing::length_prefixed);
+    AsyncJsonRpcClient asyncClient(pipelined);
+    vector<future<int>> sums;
+    for (int i = 0; i < 500; i++)
+      sums.push_back(asyncClient.CallMethodAsync<int>("add", {i, i}));
+    int failures = 0;
+    for (int i = 0; i < 500; i++)
+      failures += sums[static_cast<size_t>(i)].get() != 2 * i;
+    CHECK(failures == 0);
+
+    json statistics = connector.Statistics();
+    CHECK(statistics["engine"] == connector.Engine());
+    if (connector.Engine() == "io_uring") {
+      CHECK(statistics["requests"] == 504);
+      CHECK(statistics["enters"] > 0);
+    }
+
+    int port = connector.Port();
+    connector.StopListening();
+    CHECK_THROWS_AS(c.Send("{}"), JsonRpcException);
+    CHECK_THROWS_AS(TcpClientConnector("127.0.0.1", port), JsonRpcException);
+  }
+}
+
+TEST_CASE("io_uring connector stops with operations in flight") {
+  if (!uring::Supported())
+    return;
+  JsonRpc2Server server;
+  server.Add("blob", "", [](int size) { return string(static_cast<size_t>(size), 'z'); }, {"size"});
+  UringServerConnector connector(server, 0, Framing::newline, 1);
+  REQUIRE(connector.StartListening());
+
+  // One connection only has its receive armed, the other never reads its response, which keeps a
+  // send in the kernel
+  int idle = tcp::Connect("127.0.0.1", connector.Port());
+  int stalled = tcp::Connect("127.0.0.1", connector.Port());
+  REQUIRE(tcp::WriteAll(stalled, string(R"({"jsonrpc":"2.0","id":1,"method":"blob","params":[16000000]})"), string("\n")));
+  while (connector.Statistics()["requests"] == 0)
+    this_thread::sleep_for(chrono::milliseconds(1));
+  this_thread::sleep_for(chrono::milliseconds(50));
+
+  connector.StopListening();
+  char buffer[4096];
+  CHECK(recv(idle, buffer, sizeof(buffer), 0) <= 0);
+  ssize_t n;
+  size_t received = 0;
+  while ((n = recv(stalled, buffer, sizeof(buffer), 0)) > 0)
+    received += static_cast<size_t>(n);
+  CHECK(received < 16000000);
+  close(idle);
+  close(stalled);
+}
+
+TEST_CASE("newline framing rejects multi-line JSON") {
+  JsonRpc2Server server;
+  int calls = 0;
+  server.Add("add", "", [&calls](int a, int b) { return ++calls, a + b; }, {"a", "b"});
+  for (bool useUring : {true, false}) {
+    UringServerConnector connector(server, 0, Framing::newline, 1, "127.0.0.1", useUring);
+    REQUIRE(connector.StartListening());
+    int fd = tcp::Connect("127.0.0.1", connector.Port());
+    string request = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"add\",\"params\":[1,2]}\n";
+    REQUIRE(tcp::WriteAll(fd, request, string("{\"jsonrpc\":\"2.0\",\n\"id\":2,\"method\":\"add\",\"params\":[1,2]}\n"), request));
+    // The first request is answered, the truncated line gets a parse error and the connection closes
+    string received;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+      received.append(buffer, static_cast<size_t>(n));
+    close(fd);
+    FrameDecoder decoder(Framing::newline);
+    auto responses = Decode(decoder, received, received.size() + 1);
+    REQUIRE(responses.size() == 2);
+    CHECK(json::parse(responses[0])["result"] == 3);
+    CHECK(json::parse(responses[1])["error"]["code"] == parse_error);
+  }
+  CHECK(calls == 2);
+}
+
+TEST_CASE("json-rpc peer") {
+  CHECK(JsonRpcPeer::IsRequest(R"({"jsonrpc":"2.0","id":1,"method":"m"})"));
+  CHECK(JsonRpcPeer::IsRequest(R"({"jsonrpc":"2.0","method":"m","params":{"result":1}})"));
+  CHECK(JsonRpcPeer::IsRequest(R"([{"jsonrpc":"2.0","method":"m"},{"jsonrpc":"2.0","id":1,"result":1}])"));
+  CHECK(!JsonRpcPeer::IsRequest(R"({"jsonrpc":"2.0","id":1,"result":{"method":"m"}})"));
+  CHECK(!JsonRpcPeer::IsRequest(R"({"jsonrpc":"2.0","id":null,"error":{"code":-32700,"message":"parse error"}})"));
+  CHECK(!JsonRpcPeer::IsRequest(R"([{"jsonrpc":"2.0","id":1,"result":1}])"));
+  CHECK(JsonRpcPeer::IsRequest("[]"));
+  CHECK(JsonRpcPeer::IsRequest("{invalid"));
+
+  int listenFd = tcp::Listen("127.0.0.1", 0);
+  REQUIRE(listenFd >= 0);
+  TcpAsyncClientConnector deviceEnd("127.0.0.1", tcp::LocalPort(listenFd), Framing::length_prefixed);
+  int accepted = tcp::Accept(listenFd, chrono::seconds(5));
+  close(listenFd);
+  REQUIRE(accepted >= 0);
+  TcpAsyncClientConnector hostEnd(accepted, Framing::length_prefixed);
+
+  JsonRpcPeer host(hostEnd);
+  JsonRpcPeer device(deviceEnd);
+  promise<string> pushed;
+  device.Server().Add("status", "", []() { return string("ready"); });
+  device.Server().Add("event", NotificationHandle([&pushed](const json &params) { pushed.set_value(params[0].get<string>()); }));
+  host.Server().Add("add", "", [](int a, int b) { return a + b; }, {"a", "b"});
+  // Calls back into the device while answering it, handlers run off the reader thread by default
+  host.Server().Add("check", "", [&host]() { return host.Client().CallMethodAsync<string>("status").get(); });
+
+  CHECK(device.Client().CallMethodAsync<int>("add", {1, 2}).get() == 3);
+  CHECK(host.Client().CallMethodAsync<string>("status").get() == "ready");
+  CHECK(device.Client().CallMethodAsync<string>("check").get() == "ready");
+  host.Client().CallNotification("event", {"update"});
+  CHECK(pushed.get_future().get() == "update");
+  promise<int> missing;
+  host.Client().CallMethodAsync("add", {1, 2}, [&missing](CallResult result) {
+    auto *error = get_if<JsonRpcException>(&result);
+    missing.set_value(error != nullptr ? error->Code() : 0);
+  });
+  CHECK(missing.get_future().get() == method_not_found);
+
+  // Both directions at once, ids overlap between them
+  vector<future<int>> sums;
+  vector<future<string>> statuses;
+  for (int i = 0; i < 200; i++) {
+    sums.push_back(device.Client().CallMethodAsync<int>("add", {i, i}));
+    statuses.push_back(host.Client().CallMethodAsync<string>("status"));
+  }
+  int failures = 0;
+  for (int i = 0; i < 200; i++)
+    failures += sums[static_cast<size_t>(i)].get() != 2 * i || statuses[static_cast<size_t>(i)].get() != "ready";
+  CHECK(failures == 0);
+  CHECK(host.Client().Pending() == 0);
+  CHECK(device.Client().Pending() == 0);
+}
+
+TEST_CASE("json-rpc peer fails calls of handlers outliving it") {
+  int listenFd = tcp::Listen("127.0.0.1", 0);
+  REQUIRE(listenFd >= 0);
+  TcpAsyncClientConnector deviceEnd("127.0.0.1", tcp::LocalPort(listenFd), Framing::length_prefixed);
+  int accepted = tcp::Accept(listenFd, chrono::seconds(5));
+  close(listenFd);
+  REQUIRE(accepted >= 0);
+  TcpAsyncClientConnector hostEnd(accepted, Framing::length_prefixed);
+
+  JsonRpcPeer device(deviceEnd);
+  device.Server().Add("status", "", []() { return string("ready"); });
+  auto host = make_unique<JsonRpcPeer>(hostEnd);
+  promise<void> entered;
+  string failure;
+  // Keeps calling back until the host is destroyed under it: the call pending then, or the next one, has to fail
+  host->Server().Add("poll", "", [&, peer = host.get()]() {
+    entered.set_value();
+    while (true) {
+      try {
+        peer->Client().CallMethodAsync<string>("status").get();
+      } catch (JsonRpcException &e) {
+        failure = e.Message();
+        return 0;
+      }
+    }
+  });
+  device.Client().CallMethodAsync("poll", {}, [](CallResult) {});
+  entered.get_future().wait();
+  host.reset();
+  CHECK(failure == "peer destroyed before a response arrived");
+}
@@ -79,17 +79,17 @@ TEST_CASE("test incorrect params") {
   CHECK(notifyResult.empty());
 }
 
-enum class category { order, cash_carry };
+enum class product_category { order, cash_carry };
 
 struct product {
   product() : id(), price(), name(), cat() {}
   int id;
   double price;
   string name;
-  category cat;
+  product_category cat;
 };
 
-NLOHMANN_JSON_SERIALIZE_ENUM(category, {{category::order, "order"}, {category::cash_carry, "cc"}})
+NLOHMANN_JSON_SERIALIZE_ENUM(product_category, {{product_category::order, "order"}, {product_category::cash_carry, "cc"}})
 
 void to_json(json &j, const product &p) { j = json{{"id", p.id}, {"price", p.price}, {"name", p.name}, {"category", p.cat}}; }
 
@@ -99,7 +99,7 @@ product get_product(int id) {
     p.id = 1;
     p.price = 22.50;
     p.name = "some product";
-    p.cat = category::order;
+    p.cat = product_category::order;
     return p;
   }
   else if (id == 2) {
@@ -107,7 +107,7 @@ product get_product(int id) {
     p.id = 2;
     p.price = 55.50;
     p.name = "some product 2";
-    p.cat = category::cash_carry;
+    p.cat = product_category::cash_carry;
     return p;
   }
   throw JsonRpcException(-50000, "product not found");
@@ -119,13 +119,13 @@ TEST_CASE("test with custom struct return") {
   CHECK(j["id"] == 1);
   CHECK(j["name"] == "some product");
   CHECK(j["price"] == 22.5);
-  CHECK(j["category"] == category::order);
+  CHECK(j["category"] == product_category::order);
 
   j = mh(R"([2])"_json);
   CHECK(j["id"] == 2);
   CHECK(j["name"] == "some product 2");
   CHECK(j["price"] == 55.5);
-  CHECK(j["category"] == category::cash_carry);
+  CHECK(j["category"] == product_category::cash_carry);
 
   REQUIRE_THROWS_WITH(mh(R"([444])"_json), "product not found");
 }
@@ -143,10 +143,10 @@ bool add_products(const vector<product> &products) {
   return true;
 }
 
-string enumToString(const category& category) {
+string enumToString(const product_category &category) {
   switch (category) {
-  case category::cash_carry: return "cash&carry";
-  case category::order: return "online-order";
+  case product_category::cash_carry: return "cash&carry";
+  case product_category::order: return "online-order";
   default: return "unknown category";
   }
 }
@@ -170,11 +170,11 @@ TEST_CASE("test with custom params") {
   CHECK(catalog[0].id == 1);
   CHECK(catalog[0].name == "some product");
   CHECK(catalog[0].price == 22.5);
-  CHECK(catalog[0].cat == category::order);
+  CHECK(catalog[0].cat == product_category::order);
   CHECK(catalog[1].id == 2);
   CHECK(catalog[1].name == "some product 2");
   CHECK(catalog[1].price == 55.5);
-  CHECK(catalog[1].cat == category::cash_carry);
+  CHECK(catalog[1].cat == product_category::cash_carry);
 
   REQUIRE_THROWS_WITH(mh(R"([[{"id": 1, "price": 22.50}]])"_json), "[json.exception.out_of_range.403] key 'name' not found");
   REQUIRE_THROWS_WITH(mh(R"([{"id": 1, "price": 22.50}])"_json), "addProducts: invalid parameter \"id\" (must be array, but is object: {\"id\":1,\"price\":22.5})");
@@ -17,4 +17,18 @@ TEST_CASE_FIXTURE(IntegrationTest, "warehouse_test") {
 
   Product p2 = client.CallMethod<Product>(1, "GetProduct", {"0xff"});
   CHECK((p2.id == p.id && p2.name == p.name && p2.price == p.price && p2.cat == p.cat));
+
+  // Unlisted values and names are errors instead of mapping to the first entry
+  CHECK_THROWS_AS(nlohmann::json(static_cast<category>(7)), nlohmann::json::type_error);
+  CHECK_THROWS_AS(nlohmann::json("cash").get<category>(), nlohmann::json::type_error);
+
+  // A missing field is a client error, invalid_params rather than internal_error
+  nlohmann::json broken = p;
+  broken.erase("price");
+  try {
+    client.CallMethod<bool>(1, "AddProduct", {broken});
+    FAIL("expected invalid_params");
+  } catch (jsonrpccxx::JsonRpcException &e) {
+    CHECK(e.Code() == jsonrpccxx::invalid_params);
+  }
 }